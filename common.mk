@@ -10,6 +10,11 @@ GENGETOPT	?= gengetopt
 
 BOOST_IOSTREAMS_LIB ?= -lboost_iostreams-mt
 
+# Used for building libdivsufsort with parallel suffix sorting. May be set to
+# empty in local.mk if the compiler does not support OpenMP. Every tool that
+# links libdivsufsort needs the OpenMP runtime, hence the flags in LDFLAGS.
+OPENMP_FLAGS ?= -fopenmp
+
 WARNING_FLAGS	?=
 WARNING_FLAGS	+= \
 	-Wall -Werror -Wno-unused -Wno-missing-braces -Wstrict-aliasing \
@@ -42,7 +47,8 @@ endif
 
 LDFLAGS		=	-L../../lib/sdsl/build/lib \
 				-L../../lib/sdsl/build/external/libdivsufsort/lib \
-				$(OPT_FLAGS) $(LOCAL_LDFLAGS) -ldivsufsort -ldivsufsort64 -lsdsl
+				$(OPT_FLAGS) $(LOCAL_LDFLAGS) -ldivsufsort -ldivsufsort64 -lsdsl \
+				$(OPENMP_FLAGS)
 
 ifeq ($(BUILD_STYLE),release)
 	OPT_FLAGS	+= $(OPT_FLAGS_RELEASE)
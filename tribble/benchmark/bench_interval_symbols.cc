@@ -0,0 +1,137 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+// Measure the time taken to list the symbols of a BWT interval and their
+// ranks as in list_next_substring_characters, with the flat representation
+// of small_alphabet_wt and with a Hu-Tucker-shaped wavelet tree followed by
+// sorting the symbols. The text is random over an alphabet of the same
+// size as that of the index of DNA reads.
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <range/v3/all.hpp>
+#include <sdsl/int_vector_buffer.hpp>
+#include <sdsl/wavelet_trees.hpp>
+#include <string>
+#include <tribble/small_alphabet_wt.hh>
+#include <vector>
+
+
+namespace {
+	
+	typedef tribble::small_alphabet_wt <>	flat_wt_type;
+	typedef sdsl::wt_hutu <>				tree_wt_type;
+	typedef std::uint64_t					size_type;
+	
+	
+	template <typename t_fn>
+	void measure(
+		char const *description,
+		size_type const interval_length,
+		std::vector <size_type> const &starts,
+		t_fn &&fn
+	)
+	{
+		size_type count(0);
+		auto const start(std::chrono::steady_clock::now());
+		for (auto const i : starts)
+			count += fn(i, i + interval_length);
+		auto const end(std::chrono::steady_clock::now());
+		
+		double const ns(std::chrono::duration <double, std::nano>(end - start).count());
+		std::cout << description << '\t' << interval_length << '\t' << count << '\t' << (ns / starts.size()) << std::endl;
+	}
+}
+
+
+int main(int argc, char **argv)
+{
+	if (argc < 2 || 4 < argc)
+	{
+		std::cerr << "Usage: " << argv[0] << " text_length [query_count [seed]]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	
+	size_type const text_length(std::stoull(argv[1]));
+	size_type const query_count(3 <= argc ? std::stoull(argv[2]) : 1000000);
+	std::mt19937_64 rng(4 == argc ? std::stoull(argv[3]) : 0);
+	
+	// The terminators and the strings of the index, with one '$'.
+	std::array <char, 6> const alphabet{{'#', 'A', 'C', 'G', 'N', 'T'}};
+	std::string const fname("bench-interval-symbols.tmp");
+	
+	flat_wt_type flat_wt;
+	tree_wt_type tree_wt;
+	{
+		std::uniform_int_distribution <std::size_t> symbol_dist(0, alphabet.size() - 1);
+		sdsl::int_vector_buffer <8> buf(fname, std::ios::out);
+		for (size_type i(0); i < text_length; ++i)
+			buf[i] = alphabet[symbol_dist(rng)];
+		buf[text_length / 2] = 0;
+		
+		flat_wt_type tmp_flat(buf, text_length);
+		tree_wt_type tmp_tree(buf, text_length);
+		flat_wt.swap(tmp_flat);
+		tree_wt.swap(tmp_tree);
+		buf.close(true);
+	}
+	
+	if (!flat_wt.is_flat())
+	{
+		std::cerr << "Expected the flat representation." << std::endl;
+		return EXIT_FAILURE;
+	}
+	
+	std::cout << "method\tinterval_length\tsymbol_count\tns_per_query" << std::endl;
+	
+	std::vector <std::uint8_t> cs(256, 0);
+	std::vector <size_type> rank_c_i(256, 0);
+	std::vector <size_type> rank_c_j(256, 0);
+	for (size_type const interval_length : {2, 16, 200, 100000})
+	{
+		if (text_length < interval_length)
+			continue;
+		
+		std::uniform_int_distribution <size_type> start_dist(0, text_length - interval_length);
+		std::vector <size_type> starts(query_count);
+		for (auto &start : starts)
+			start = start_dist(rng);
+		
+		measure("small_alphabet_wt", interval_length, starts, [&](size_type const i, size_type const j){
+			std::array <size_type, flat_wt_type::MAX_SIGMA> ranks_i;
+			std::array <size_type, flat_wt_type::MAX_SIGMA> ranks_j;
+			size_type k(0);
+			flat_wt.interval_symbols(i, j, k, cs, ranks_i, ranks_j);
+			return k;
+		});
+		
+		measure("wt_hutu+sort", interval_length, starts, [&](size_type const i, size_type const j){
+			size_type k(0);
+			sdsl::interval_symbols(tree_wt, i, j, k, cs, rank_c_i, rank_c_j);
+			
+			auto range(ranges::view::take_exactly(ranges::view::zip(cs, rank_c_i, rank_c_j), k));
+			ranges::sort(range, [](auto const &lhs, auto const &rhs) -> bool {
+				return std::get <0>(lhs) < std::get <0>(rhs);
+			});
+			return k;
+		});
+	}
+	
+	return EXIT_SUCCESS;
+}
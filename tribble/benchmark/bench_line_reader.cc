@@ -0,0 +1,105 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+// Measure the throughput of splitting a file into lines with getline and
+// with line_block_reader, and of finding FASTA records in a mapped file
+// with find_line_beginning_with. The file should be in the page cache,
+// e.g. read once before running, for the results to be comparable.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <tribble/find_character.hh>
+#include <tribble/io.hh>
+#include <tribble/line_block_reader.hh>
+
+
+namespace {
+	
+	template <typename t_fn>
+	void measure(char const *description, std::size_t const byte_count, std::size_t const repeat, t_fn &&fn)
+	{
+		std::size_t count(0);
+		auto const start(std::chrono::steady_clock::now());
+		for (std::size_t i(0); i < repeat; ++i)
+			count += fn();
+		auto const end(std::chrono::steady_clock::now());
+		
+		double const seconds(std::chrono::duration <double>(end - start).count());
+		double const gb_per_s(repeat * byte_count / seconds / 1e9);
+		std::cout << description << '\t' << (count / repeat) << '\t' << gb_per_s << std::endl;
+	}
+}
+
+
+int main(int argc, char **argv)
+{
+	if (argc < 2 || 3 < argc)
+	{
+		std::cerr << "Usage: " << argv[0] << " input_file [repeat]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	
+	char const *fname(argv[1]);
+	std::size_t const repeat(3 == argc ? std::stoul(argv[2]) : 5);
+	
+	tribble::mapped_file file;
+	tribble::open_file_for_reading(fname, file);
+	std::size_t const size(file.size());
+	
+	std::cout << "method\tcount\tGB/s" << std::endl;
+	
+	measure("getline", size, repeat, [fname](){
+		tribble::file_istream stream;
+		tribble::open_file_for_reading(fname, stream);
+		
+		std::size_t count(0);
+		std::string line;
+		while (std::getline(stream, line))
+			++count;
+		return count;
+	});
+	
+	measure("line_block_reader", size, repeat, [fname](){
+		tribble::file_istream stream;
+		tribble::open_file_for_reading(fname, stream);
+		tribble::line_block_reader reader(stream);
+		
+		std::size_t count(0);
+		char const *line(nullptr);
+		std::size_t length(0);
+		while (reader.read_line(line, length))
+			++count;
+		return count;
+	});
+	
+	measure("find_line_beginning_with", size, repeat, [&file](){
+		auto const *begin(file.data());
+		auto const *end(begin + file.size());
+		auto const *pos(begin);
+		
+		std::size_t count(0);
+		while (end != (pos = tribble::find_line_beginning_with(begin, pos, end, '>')))
+		{
+			++count;
+			++pos;
+		}
+		return count;
+	});
+	
+	return EXIT_SUCCESS;
+}
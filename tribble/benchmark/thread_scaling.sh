@@ -0,0 +1,33 @@
+#!/bin/bash
+
+# Measure the index construction and the superstring search with 1 to the
+# given number of threads. The times of the steps are taken from the
+# progress messages of find-superstring.
+
+input=$1
+max_threads=$2
+shift 2
+
+if [ -z "$input" -o -z "$max_threads" ];
+	then echo "Usage: $0 input.fa max_threads [additional options for --create-index]";
+	exit 1
+fi
+
+tool="$(dirname "$0")/../find-superstring/find-superstring"
+work_dir=$(mktemp -d)
+trap 'rm -rf "${work_dir}"' EXIT
+
+printf "threads\tstep\tms\n"
+for threads in $(seq 1 "${max_threads}")
+do
+	index="${work_dir}/index.sdsl"
+	strings="${work_dir}/index.strings"
+	rm -f "${index}" "${index}.cache" "${strings}"
+	
+	# Run in the working directory, since the cache files may be written there.
+	(cd "${work_dir}" && "${tool}" -C -f "${input}" -i "${index}" -s "${strings}" --threads="${threads}" "$@") 2>&1 >/dev/null | \
+		sed -n -E "s/^(.*[^ ])….* finished in ([0-9]+) ms.*$/${threads}\t\1\t\2/p"
+	
+	"${tool}" -F --no-string-cache -i "${index}" -s "${strings}" --threads="${threads}" 2>&1 >/dev/null | \
+		sed -n -E "s/^(.*[^ ])….* finished in ([0-9]+) ms.*$/${threads}\t\1\t\2/p"
+done
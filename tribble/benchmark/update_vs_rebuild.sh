@@ -0,0 +1,43 @@
+#!/bin/bash
+
+# Compare adding strings to an existing index with --update-index against
+# constructing the index of all the strings with --create-index. The base
+# index is constructed first and is not included in the times. The
+# resulting strings files are compared to check that the results match.
+
+base=$1
+added=$2
+shift 2
+
+if [ -z "$base" -o -z "$added" ];
+	then echo "Usage: $0 base.fa added.fa [additional options for --create-index]";
+	exit 1
+fi
+
+# The commands are run in a temporary directory.
+base=$(realpath "${base}")
+added=$(realpath "${added}")
+tool=$(realpath "$(dirname "$0")/../find-superstring/find-superstring")
+work_dir=$(mktemp -d)
+trap 'rm -rf "${work_dir}"' EXIT
+cd "${work_dir}"
+
+milliseconds() { date +%s%3N; }
+
+"${tool}" -C -f "${base}" -i base.sdsl -s base.strings "$@" 2>/dev/null || exit 1
+
+start=$(milliseconds)
+"${tool}" -U -a "${added}" --base-index-file=base.sdsl --base-strings-file=base.strings -i updated.sdsl -s updated.strings 2>/dev/null || exit 1
+update_ms=$(( $(milliseconds) - start ))
+
+start=$(milliseconds)
+"${tool}" -C -f "${base}" -f "${added}" -i rebuilt.sdsl -s rebuilt.strings "$@" 2>/dev/null || exit 1
+rebuild_ms=$(( $(milliseconds) - start ))
+
+printf "base_bytes\tadded_bytes\tupdate_ms\trebuild_ms\n"
+printf "%s\t%s\t%s\t%s\n" "$(stat -c %s "${base}")" "$(stat -c %s "${added}")" "${update_ms}" "${rebuild_ms}"
+
+if ! cmp -s updated.strings rebuilt.strings;
+	then echo "The strings files differ." >&2;
+	exit 1
+fi
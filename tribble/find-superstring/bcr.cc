@@ -0,0 +1,468 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dispatch/dispatch.h>
+#include <sdsl/construct.hpp>
+#include <sdsl/int_vector_buffer.hpp>
+#include <sdsl/io.hpp>
+#include <sdsl/wt_huff.hpp>
+#include <stdexcept>
+#include <string>
+#include <tribble/dispatch_fn.hh>
+#include <unistd.h>
+#include <vector>
+#include "bcr.hh"
+#include "bwt_merge.hh"
+
+
+namespace tribble { namespace detail {
+	
+	// Position of the most recently inserted suffix of a string in the
+	// partial BWT and the text position of the first character of the suffix.
+	struct bcr_item
+	{
+		std::uint64_t	position{0};
+		std::uint64_t	cursor{0};
+		
+		bcr_item() = default;
+		
+		bcr_item(std::uint64_t const position_, std::uint64_t const cursor_):
+			position(position_),
+			cursor(cursor_)
+		{
+		}
+	};
+	
+	
+	class bcr_builder
+	{
+	protected:
+		typedef std::array <std::uint64_t, 256> count_array;
+		
+	protected:
+		std::vector <bcr_item>	m_items;			// Sorted by position.
+		std::vector <bcr_item>	m_sorted_items;		// Buffer for the next iteration.
+		std::uint8_t const		*m_text{nullptr};
+		std::uint8_t			*m_bwt{nullptr};	// The partial BWT.
+		std::size_t				m_bwt_size{0};
+		std::size_t				m_string_count{0};
+		std::uint8_t			m_sentinel{};
+		
+	protected:
+		void insert_terminators();
+		bool insert_next_column();
+		
+	public:
+		bcr_builder(std::uint8_t const *text, std::size_t const string_count, std::uint8_t const sentinel, std::uint8_t *bwt):
+			m_text(text),
+			m_bwt(bwt),
+			m_string_count(string_count),
+			m_sentinel(sentinel)
+		{
+		}
+		
+		std::size_t bwt_size() const { return m_bwt_size; }
+		
+		void build()
+		{
+			insert_terminators();
+			while (insert_next_column())
+				;
+		}
+	};
+	
+	
+	void bcr_builder::insert_terminators()
+	{
+		// The suffix that consists of the terminator of the last string is
+		// followed by $ in the text and hence is the smallest. The other
+		// terminators are ordered by the index of the string since the
+		// strings are sorted.
+		m_items.resize(m_string_count);
+		m_sorted_items.reserve(m_string_count);
+		
+		std::size_t string_idx(0);
+		std::uint64_t text_pos(1);
+		while (string_idx < m_string_count)
+		{
+			// Find the end of the string.
+			while (m_sentinel != m_text[text_pos])
+				++text_pos;
+			
+			// Store the last character of the string or the sentinel that
+			// precedes the string if it is empty.
+			auto const row(string_idx + 1 == m_string_count ? 0 : string_idx + 1);
+			m_bwt[row] = m_text[text_pos - 1];
+			m_items[row] = bcr_item(row, text_pos - 1);
+			
+			++string_idx;
+			++text_pos;
+		}
+		
+		m_bwt_size = m_string_count;
+	}
+	
+	
+	bool bcr_builder::insert_next_column()
+	{
+		// Determine the rank of the first character of each active suffix
+		// among the characters of the partial BWT that precede the suffix's
+		// row. Store the rank to the position field.
+		count_array counts{};
+		std::size_t bwt_pos(0);
+		auto items_end(m_items.begin());
+		for (auto const &item : m_items)
+		{
+			auto const c(m_text[item.cursor]);
+			assert(m_bwt[item.position] == c);
+			
+			while (bwt_pos < item.position)
+				++counts[m_bwt[bwt_pos++]];
+			
+			// Skip the strings that have been handled.
+			if (m_sentinel == c)
+				continue;
+			
+			*items_end = bcr_item(counts[c], item.cursor);
+			++items_end;
+		}
+		
+		m_items.erase(items_end, m_items.end());
+		if (m_items.empty())
+			return false;
+		
+		while (bwt_pos < m_bwt_size)
+			++counts[m_bwt[bwt_pos++]];
+		
+		// Determine the first rows of the suffixes that begin with each
+		// character. The terminators are smallest.
+		count_array starts{};
+		count_array item_starts{};
+		{
+			count_array item_counts{};
+			for (auto const &item : m_items)
+				++item_counts[m_text[item.cursor]];
+			
+			std::uint64_t start(m_string_count);
+			std::uint64_t item_start(0);
+			for (std::size_t i(0); i < 256; ++i)
+			{
+				if (m_sentinel == i)
+					continue;
+				
+				starts[i] = start;
+				item_starts[i] = item_start;
+				start += counts[i];
+				item_start += item_counts[i];
+			}
+		}
+		
+		// Sort the suffixes by their new rows using counting sort. The items
+		// are already in the order of the ranks.
+		m_sorted_items.resize(m_items.size());
+		for (auto const &item : m_items)
+		{
+			auto const c(m_text[item.cursor]);
+			m_sorted_items[item_starts[c]++] = bcr_item(starts[c] + item.position, item.cursor - 1);
+		}
+		
+		// Insert the preceding characters to the new rows. Since the relative
+		// order of the existing rows does not change, merge from the end.
+		{
+			std::size_t src(m_bwt_size);
+			std::size_t dst(m_bwt_size + m_sorted_items.size());
+			auto it(m_sorted_items.crbegin());
+			auto const end(m_sorted_items.crend());
+			while (it != end)
+			{
+				--dst;
+				if (it->position == dst)
+				{
+					m_bwt[dst] = m_text[it->cursor];
+					++it;
+				}
+				else
+				{
+					m_bwt[dst] = m_bwt[--src];
+				}
+			}
+			
+			m_bwt_size += m_sorted_items.size();
+		}
+		
+		m_items.swap(m_sorted_items);
+		return true;
+	}
+	
+	
+	// A range of the sorted strings and its BWT.
+	// A file created next to the given one that is removed when the object
+	// is destroyed or another file is assigned to it.
+	class temporary_file
+	{
+	protected:
+		std::string	m_path;
+		
+	public:
+		temporary_file() = default;
+		temporary_file(temporary_file const &) = delete;
+		temporary_file(temporary_file &&other) { *this = std::move(other); }
+		~temporary_file() { remove(); }
+		
+		temporary_file &operator=(temporary_file const &) = delete;
+		temporary_file &operator=(temporary_file &&other)
+		{
+			remove();
+			m_path = std::move(other.m_path);
+			other.m_path.clear();
+			return *this;
+		}
+		
+		void create(char const *neighbour_fname)
+		{
+			assert(m_path.empty());
+			
+			// Place the file next to the given one since /tmp may reside in memory.
+			std::string path_template(neighbour_fname);
+			path_template += ".bwt.XXXXXX";
+			
+			int const fd(mkstemp(&path_template[0]));
+			if (-1 == fd)
+			{
+				std::string message("Unable to create a temporary file: ");
+				message += std::strerror(errno);
+				throw std::runtime_error(message);
+			}
+			
+			::close(fd);
+			m_path = std::move(path_template);
+		}
+		
+		void remove()
+		{
+			if (!m_path.empty())
+			{
+				unlink(m_path.c_str());
+				m_path.clear();
+			}
+		}
+		
+		std::string const &path() const { return m_path; }
+	};
+	
+	
+	void store_bwt(sdsl::int_vector <8> const &bwt, std::string const &fname)
+	{
+		if (!sdsl::store_to_file(bwt, fname))
+			throw std::runtime_error("Unable to write the BWT.");
+	}
+	
+	
+	struct bcr_shard
+	{
+		temporary_file			bwt_file;
+		std::size_t				string_count{0};
+		std::uint64_t			text_begin{0};			// Position of the sentinel that precedes the first string.
+		std::uint64_t			text_end{0};			// Position after the sentinel that follows the last string.
+		std::uint64_t			last_string_begin{0};
+		std::size_t				last_string_length{0};
+	};
+	
+	
+	// Call fn for each index in [0, count) using at most thread_count threads.
+	template <typename t_fn>
+	void apply_with_threads(std::size_t const count, std::size_t const thread_count, t_fn &&fn)
+	{
+		std::size_t const worker_count(std::max(std::size_t(1), std::min(count, thread_count)));
+		dispatch_queue_t queue(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+		dispatch_apply_fn(worker_count, queue, [&fn, count, worker_count](std::size_t const worker_idx) {
+			for (std::size_t i(worker_idx); i < count; i += worker_count)
+				fn(i);
+		});
+	}
+}}
+
+
+namespace tribble {
+	
+	void construct_bwt_bcr(
+		sdsl::int_vector <8> const &text,
+		std::size_t const string_count,
+		std::uint8_t const sentinel,
+		sdsl::int_vector <8> /* out */ &bwt
+	)
+	{
+		// The BWT of #s_1#…#s_m#$ consists of the row of $, which has the
+		// last sentinel, the row of #$ followed by the row of #s_1#…, which
+		// has $, and the rows of the multi-string BWT of the strings with
+		// the terminators ordered s_m, s_1, …, s_{m - 1}.
+		bwt.resize(text.size());
+		if (0 == string_count)
+		{
+			std::fill(bwt.begin(), bwt.end(), 0);
+			return;
+		}
+		
+		// The elements of int_vector <8> are stored as consecutive bytes.
+		auto const *text_bytes(reinterpret_cast <std::uint8_t const *>(text.data()));
+		auto *bwt_bytes(reinterpret_cast <std::uint8_t *>(bwt.data()));
+		
+		detail::bcr_builder builder(text_bytes, string_count, sentinel, bwt_bytes + 2);
+		builder.build();
+		assert(2 + builder.bwt_size() == bwt.size());
+		
+		bwt_bytes[0] = sentinel;
+		bwt_bytes[1] = bwt_bytes[2];
+		bwt_bytes[2] = 0;
+	}
+	
+	
+	void construct_bwt_bcr_sharded(
+		std::uint8_t const *text,
+		std::size_t const text_length,
+		sdsl::int_vector <> const &string_lengths,
+		std::uint8_t const sentinel,
+		std::size_t const shard_count,
+		std::size_t const thread_count,
+		char const *neighbour_fname,
+		std::string const &bwt_fname
+	)
+	{
+		auto const string_count(string_lengths.size());
+		if (shard_count <= 1 || string_count <= 1)
+		{
+			sdsl::int_vector <8> bwt;
+			{
+				sdsl::int_vector <8> text_copy(1 + text_length, 0);
+				std::copy_n(text, text_length, reinterpret_cast <std::uint8_t *>(text_copy.data()));
+				construct_bwt_bcr(text_copy, string_count, sentinel, bwt);
+			}
+			detail::store_bwt(bwt, bwt_fname);
+			return;
+		}
+		
+		// Divide the strings into shards of roughly equal text size.
+		std::vector <detail::bcr_shard> shards;
+		{
+			auto const target_size(1 + text_length / std::min(shard_count, string_count));
+			std::uint64_t text_pos(0);
+			detail::bcr_shard shard;
+			for (std::size_t i(0); i < string_count; ++i)
+			{
+				std::size_t const length(string_lengths[i]);
+				shard.last_string_begin = 1 + text_pos;
+				shard.last_string_length = length;
+				++shard.string_count;
+				text_pos += 1 + length;
+				
+				if (target_size <= text_pos - shard.text_begin || 1 + i == string_count)
+				{
+					shard.text_end = 1 + text_pos;
+					shards.emplace_back(std::move(shard));
+					shard = detail::bcr_shard();
+					shard.text_begin = text_pos;
+				}
+			}
+		}
+		
+		assert(text_length == shards.back().text_end);
+		
+		// Construct the BWT of each shard from a copy of its part of the text
+		// and write it to a temporary file, or to the given file if there is
+		// only one shard.
+		auto const *text_bytes(text);
+		bool const has_one_shard(1 == shards.size());
+		detail::apply_with_threads(shards.size(), thread_count, [&shards, &bwt_fname, text_bytes, sentinel, neighbour_fname, has_one_shard](std::size_t const i) {
+			auto &shard(shards[i]);
+			sdsl::int_vector <8> bwt;
+			{
+				auto const size(shard.text_end - shard.text_begin);
+				sdsl::int_vector <8> shard_text(1 + size, 0);
+				std::copy_n(text_bytes + shard.text_begin, size, reinterpret_cast <std::uint8_t *>(shard_text.data()));
+				construct_bwt_bcr(shard_text, shard.string_count, sentinel, bwt);
+			}
+			
+			if (has_one_shard)
+				detail::store_bwt(bwt, bwt_fname);
+			else
+			{
+				shard.bwt_file.create(neighbour_fname);
+				detail::store_bwt(bwt, shard.bwt_file.path());
+			}
+		});
+		
+		// Merge adjacent shards until one remains. The interleaving is
+		// determined with wavelet trees of the BWTs, after which the BWTs
+		// are read from their files in order and the merged BWT is written
+		// to a temporary file, or to the given file in the last merge.
+		while (1 < shards.size())
+		{
+			auto const pair_count(shards.size() / 2);
+			bool const is_last_merge(2 == shards.size());
+			detail::apply_with_threads(pair_count, thread_count, [&shards, &bwt_fname, text_bytes, neighbour_fname, is_last_merge](std::size_t const i) {
+				auto &lhs(shards[2 * i]);
+				auto &rhs(shards[2 * i + 1]);
+				
+				bwt_interleaving interleaving;
+				{
+					sdsl::wt_huff <> lhs_wt;
+					sdsl::wt_huff <> rhs_wt;
+					sdsl::construct(lhs_wt, lhs.bwt_file.path(), 0);
+					sdsl::construct(rhs_wt, rhs.bwt_file.path(), 0);
+					
+					interleaving.construct(
+						lhs_wt,
+						lhs.string_count,
+						text_bytes + lhs.last_string_begin,
+						lhs.last_string_length,
+						rhs_wt,
+						rhs.string_count
+					);
+				}
+				
+				detail::temporary_file merged_file;
+				if (!is_last_merge)
+					merged_file.create(neighbour_fname);
+				
+				{
+					sdsl::int_vector_buffer <8> lhs_bwt(lhs.bwt_file.path(), std::ios::in);
+					sdsl::int_vector_buffer <8> rhs_bwt(rhs.bwt_file.path(), std::ios::in);
+					sdsl::int_vector_buffer <8> merged_bwt(is_last_merge ? bwt_fname : merged_file.path(), std::ios::out);
+					interleaving.merge(lhs_bwt, rhs_bwt, merged_bwt);
+				}
+				
+				lhs.bwt_file = std::move(merged_file);
+				rhs.bwt_file.remove();
+				lhs.string_count += rhs.string_count;
+				lhs.text_end = rhs.text_end;
+				lhs.last_string_begin = rhs.last_string_begin;
+				lhs.last_string_length = rhs.last_string_length;
+			});
+			
+			// Remove the merged shards.
+			std::size_t dst(1);
+			for (std::size_t i(2), count(shards.size()); i < count; i += 2)
+				shards[dst++] = std::move(shards[i]);
+			shards.resize(dst);
+		}
+	}
+}
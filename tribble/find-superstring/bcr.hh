@@ -0,0 +1,69 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_BCR_HH
+#define TRIBBLE_BCR_HH
+
+#include <cstdint>
+#include <sdsl/int_vector.hpp>
+#include <string>
+
+
+namespace tribble {
+	
+	// Construct the BWT of the text #s_1#s_2#…#s_m#$ column by column in the
+	// manner of the BCR algorithm by Bauer, Cox and Rosone without
+	// constructing the suffix array. The strings are expected to be sorted
+	// and unique, the sentinel should be smaller than the other characters
+	// and the text should be terminated with a zero as produced by
+	// strings_writer. The memory needed in addition to the text and the BWT
+	// is 32 bytes per string.
+	void construct_bwt_bcr(
+		sdsl::int_vector <8> const &text,
+		std::size_t const string_count,
+		std::uint8_t const sentinel,
+		sdsl::int_vector <8> /* out */ &bwt
+	);
+	
+	// Construct the BWT of the same text by splitting the strings into the
+	// given number of lexicographic shards, constructing the BWT of each
+	// shard with BCR and merging the BWTs pairwise, and write it to the
+	// given file as a serialized int_vector. The text is given as the
+	// contents of the strings file, i.e. without the final zero, and each
+	// shard copies its part of it. If the contents are mapped from the file,
+	// the whole text need not be resident. At most thread_count shards or
+	// pairs are processed simultaneously.
+	//
+	// The BWTs of the shards and the intermediate merges are kept in
+	// temporary files next to neighbour_fname. Constructing the BWT of a
+	// shard needs memory proportional to its part of the text. A merge
+	// needs the Huffman-shaped wavelet trees of the two BWTs and one bit
+	// per character of the result, which is written through a buffer, so
+	// the last merge still needs memory proportional to the whole text,
+	// albeit less than the BWT itself for small alphabets.
+	void construct_bwt_bcr_sharded(
+		std::uint8_t const *text,
+		std::size_t const text_length,
+		sdsl::int_vector <> const &string_lengths,
+		std::uint8_t const sentinel,
+		std::size_t const shard_count,
+		std::size_t const thread_count,
+		char const *neighbour_fname,
+		std::string const &bwt_fname
+	);
+}
+
+#endif
@@ -0,0 +1,575 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_BWT_MERGE_HH
+#define TRIBBLE_BWT_MERGE_HH
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <sdsl/int_vector.hpp>
+#include <vector>
+
+
+namespace tribble {
+	
+	// A string to be added to the BWT of #s_1#…#s_m#$. rank is the number
+	// of the existing strings that are lexicographically smaller.
+	struct bwt_merge_string
+	{
+		std::uint8_t const	*data{nullptr};
+		std::size_t			length{0};
+		std::size_t			rank{0};
+		
+		bwt_merge_string() = default;
+		
+		bwt_merge_string(std::uint8_t const *data_, std::size_t const length_, std::size_t const rank_):
+			data(data_),
+			length(length_),
+			rank(rank_)
+		{
+		}
+	};
+	
+	
+	namespace detail {
+		
+		// A row of the merged BWT that belongs to a suffix of an added string.
+		struct bwt_merge_row
+		{
+			std::uint64_t	old_rank{0};		// Number of the existing rows that are smaller.
+			std::uint32_t	string_idx{0};
+			std::uint32_t	suffix_length{0};	// Not counting the terminator.
+			
+			bwt_merge_row() = default;
+			
+			bwt_merge_row(std::uint64_t const old_rank_, std::uint32_t const string_idx_, std::uint32_t const suffix_length_):
+				old_rank(old_rank_),
+				string_idx(string_idx_),
+				suffix_length(suffix_length_)
+			{
+			}
+		};
+		
+		
+		typedef std::array <std::uint64_t, 256> bwt_count_array;
+		
+		
+		// Count the characters of the BWT and determine the first row of the
+		// suffixes that begin with each character.
+		template <typename t_bwt>
+		void bwt_starts(t_bwt const &bwt, bwt_count_array &starts)
+		{
+			bwt_count_array counts{};
+			for (std::size_t i(0), size(bwt.size()); i < size; ++i)
+				++counts[bwt[i]];
+			
+			std::uint64_t start(0);
+			for (std::size_t i(0); i < 256; ++i)
+			{
+				starts[i] = start;
+				start += counts[i];
+			}
+		}
+		
+		
+		// The rows of the suffixes of the last string of a BWT that come
+		// first among the rows with the same suffix up to and including the
+		// terminator. If a larger string is added, they have to be moved to
+		// the end of their groups, after which rank needs to be adjusted
+		// inside the groups.
+		class last_string_rows
+		{
+		protected:
+			struct group
+			{
+				std::uint64_t	begin{0};
+				std::uint64_t	end{0};
+				std::uint8_t	first_character{0};
+				
+				group() = default;
+				
+				group(std::uint64_t const begin_, std::uint64_t const end_, std::uint8_t const first_character_):
+					begin(begin_),
+					end(end_),
+					first_character(first_character_)
+				{
+				}
+			};
+			
+		protected:
+			std::vector <group>	m_groups;	// Sorted by begin.
+			
+		protected:
+			// Find the group that contains the given row.
+			typename std::vector <group>::const_iterator find_group(std::uint64_t const row) const
+			{
+				auto it(std::upper_bound(m_groups.cbegin(), m_groups.cend(), row, [](std::uint64_t const row, group const &group) {
+					return row < group.begin;
+				}));
+				
+				if (it != m_groups.cbegin())
+				{
+					--it;
+					if (row < it->end)
+						return it;
+				}
+				return m_groups.cend();
+			}
+			
+		public:
+			// Locate the groups with backward search. The rows that begin
+			// with the terminator follow the row of $.
+			template <typename t_bwt>
+			void locate(
+				t_bwt const &bwt,
+				bwt_count_array const &starts,
+				std::size_t const string_count,
+				std::uint8_t const *last_string,
+				std::size_t const last_string_length
+			)
+			{
+				m_groups.clear();
+				m_groups.reserve(1 + last_string_length);
+				std::uint64_t begin(1);
+				std::uint64_t end(2 + string_count);
+				std::size_t i(last_string_length);
+				while (true)
+				{
+					m_groups.emplace_back(begin, end, bwt[begin]);
+					if (0 == i)
+						break;
+					
+					auto const c(last_string[--i]);
+					begin = starts[c] + bwt.rank(begin, c);
+					end = starts[c] + bwt.rank(end, c);
+				}
+				
+				std::sort(m_groups.begin(), m_groups.end(), [](group const &lhs, group const &rhs) {
+					return lhs.begin < rhs.begin;
+				});
+			}
+			
+			// Move the first row of each group to the end.
+			void move_rows(std::uint8_t *bwt_bytes) const
+			{
+				for (auto const &group : m_groups)
+					std::rotate(bwt_bytes + group.begin, bwt_bytes + group.begin + 1, bwt_bytes + group.end);
+			}
+			
+			// The position of the given row after moving the rows.
+			std::uint64_t moved_row(std::uint64_t const row) const
+			{
+				auto const it(find_group(row));
+				if (it == m_groups.cend())
+					return row;
+				return (it->begin == row ? it->end - 1 : row - 1);
+			}
+			
+			// The position of the given row before moving the rows.
+			std::uint64_t original_row(std::uint64_t const row) const
+			{
+				auto const it(find_group(row));
+				if (it == m_groups.cend())
+					return row;
+				return (it->end - 1 == row ? it->begin : row + 1);
+			}
+			
+			// Rank in the BWT after moving the rows.
+			template <typename t_bwt>
+			std::uint64_t rank(t_bwt const &bwt, std::uint64_t const pos, std::uint8_t const c) const
+			{
+				auto const it(find_group(pos));
+				if (it != m_groups.cend())
+					return bwt.rank(1 + pos, c) - (it->first_character == c ? 1 : 0);
+				return bwt.rank(pos, c);
+			}
+		};
+	}
+	
+	
+	// The positions of the rows of the existing BWT and those of the added
+	// strings in the merged BWT, as well as the indices of the strings in
+	// the merged text. Produced by merge_bwt, the memory use is linear in
+	// the number of the added rows.
+	//
+	// Each row other than that of $ corresponds to a suffix x of one of the
+	// strings followed by the terminator. The rows with equal x are ordered
+	// by the rank of the string except that the last string comes first
+	// since its terminator is followed by $. The existing rows do not
+	// change, so the rows of each added string are located with backward
+	// search. If the largest string is added, the rows of the previously
+	// last string are first moved to the end of their groups of equal
+	// suffixes.
+	class bwt_merge_row_map
+	{
+	public:
+		typedef std::uint64_t size_type;
+		
+	protected:
+		detail::last_string_rows				m_moved_rows;
+		std::vector <detail::bwt_merge_row>		m_rows;				// Sorted by the position in the merged BWT.
+		std::vector <size_type>					m_string_ranks;		// Ranks of the added strings.
+		std::vector <size_type>					m_row_offsets;		// Index of the first row of each added string in m_merged_rows.
+		std::vector <size_type>					m_merged_rows;		// Positions of the added rows by string and suffix length.
+		size_type								m_old_size{0};
+		size_type								m_old_string_count{0};
+		
+	public:
+		template <typename t_bwt>
+		void construct(
+			t_bwt const &old_bwt,
+			detail::bwt_count_array const &starts,
+			std::size_t const old_string_count,
+			std::uint8_t const *last_string,
+			std::size_t const last_string_length,
+			std::vector <bwt_merge_string> const &added_strings
+		);
+		
+		// Move the rows of the previously last string in a copy of the existing BWT.
+		void move_rows(std::uint8_t *bwt_bytes) const { m_moved_rows.move_rows(bwt_bytes); }
+		
+		size_type old_size() const { return m_old_size; }
+		size_type old_string_count() const { return m_old_string_count; }
+		size_type added_string_count() const { return m_string_ranks.size(); }
+		size_type size() const { return m_old_size + m_rows.size(); }
+		
+		// The rows of the added strings in the order of the merged BWT.
+		// The position of added_rows()[i] in the merged BWT is its old_rank + i.
+		std::vector <detail::bwt_merge_row> const &added_rows() const { return m_rows; }
+		
+		// The position of the given existing row in the merged BWT.
+		size_type merged_row(size_type const old_row) const
+		{
+			auto const row(m_moved_rows.moved_row(old_row));
+			auto const it(std::upper_bound(m_rows.cbegin(), m_rows.cend(), row, [](size_type const row, detail::bwt_merge_row const &merge_row) {
+				return row < merge_row.old_rank;
+			}));
+			return row + (it - m_rows.cbegin());
+		}
+		
+		// The existing row at the given position of the merged BWT, which is
+		// preceded by preceding_added_rows added rows.
+		size_type old_row(size_type const merged_row, size_type const preceding_added_rows) const
+		{
+			assert(preceding_added_rows <= merged_row);
+			return m_moved_rows.original_row(merged_row - preceding_added_rows);
+		}
+		
+		// The position of the given suffix of an added string in the merged BWT.
+		size_type added_row(size_type const string_idx, size_type const suffix_length) const
+		{
+			return m_merged_rows[m_row_offsets[string_idx] + suffix_length];
+		}
+		
+		// The index of the given existing string in the merged text.
+		size_type merged_string_index(size_type const old_string_idx) const
+		{
+			auto const it(std::upper_bound(m_string_ranks.cbegin(), m_string_ranks.cend(), old_string_idx));
+			return old_string_idx + (it - m_string_ranks.cbegin());
+		}
+		
+		// The index of the given added string in the merged text.
+		size_type added_string_index(size_type const string_idx) const
+		{
+			return m_string_ranks[string_idx] + string_idx;
+		}
+	};
+	
+	
+	template <typename t_bwt>
+	void bwt_merge_row_map::construct(
+		t_bwt const &old_bwt,
+		detail::bwt_count_array const &starts,
+		std::size_t const old_string_count,
+		std::uint8_t const *last_string,
+		std::size_t const last_string_length,
+		std::vector <bwt_merge_string> const &added_strings
+	)
+	{
+		assert(old_string_count);
+		std::size_t const added_count(added_strings.size());
+		bool const last_is_added(added_count && old_string_count == added_strings.back().rank);
+		
+		m_old_size = old_bwt.size();
+		m_old_string_count = old_string_count;
+		
+		if (last_is_added)
+			m_moved_rows.locate(old_bwt, starts, old_string_count, last_string, last_string_length);
+		
+		m_rows.clear();
+		m_string_ranks.clear();
+		m_row_offsets.clear();
+		m_string_ranks.reserve(added_count);
+		m_row_offsets.reserve(added_count);
+		{
+			size_type row_count(0);
+			for (auto const &str : added_strings)
+			{
+				m_string_ranks.push_back(str.rank);
+				m_row_offsets.push_back(row_count);
+				row_count += 1 + str.length;
+			}
+			m_rows.reserve(row_count);
+		}
+		
+		// Locate the rows of the added strings with backward search.
+		for (std::size_t i(0); i < added_count; ++i)
+		{
+			auto const &str(added_strings[i]);
+			
+			// Count the rows of $, the first terminator, the terminators of
+			// the smaller strings and that of the last string if it was not
+			// moved.
+			std::uint64_t old_rank(
+				last_is_added && 1 + i == added_count
+				? 1
+				: 2 + str.rank + (last_is_added ? 0 : 1)
+			);
+			
+			std::size_t j(str.length);
+			while (true)
+			{
+				m_rows.emplace_back(old_rank, i, str.length - j);
+				if (0 == j)
+					break;
+				
+				auto const c(str.data[--j]);
+				old_rank = starts[c] + m_moved_rows.rank(old_bwt, old_rank, c);
+			}
+		}
+		
+		// Sort the added rows. The rows with the same number of smaller
+		// existing rows are ordered by their suffixes and then by the
+		// ranks of the strings.
+		std::sort(m_rows.begin(), m_rows.end(), [&added_strings, last_is_added, added_count](detail::bwt_merge_row const &lhs, detail::bwt_merge_row const &rhs) {
+			if (lhs.old_rank != rhs.old_rank)
+				return lhs.old_rank < rhs.old_rank;
+			
+			auto const &lhs_str(added_strings[lhs.string_idx]);
+			auto const &rhs_str(added_strings[rhs.string_idx]);
+			auto const *lhs_suffix(lhs_str.data + lhs_str.length - lhs.suffix_length);
+			auto const *rhs_suffix(rhs_str.data + rhs_str.length - rhs.suffix_length);
+			auto const res(std::memcmp(lhs_suffix, rhs_suffix, std::min(lhs.suffix_length, rhs.suffix_length)));
+			if (res)
+				return res < 0;
+			if (lhs.suffix_length != rhs.suffix_length)
+				return lhs.suffix_length < rhs.suffix_length;
+			
+			// The terminator of the last string is the smallest.
+			if (last_is_added)
+			{
+				if (1 + rhs.string_idx == added_count)
+					return false;
+				if (1 + lhs.string_idx == added_count)
+					return true;
+			}
+			return lhs.string_idx < rhs.string_idx;
+		});
+		
+		m_merged_rows.resize(m_rows.size());
+		for (size_type i(0), count(m_rows.size()); i < count; ++i)
+		{
+			auto const &row(m_rows[i]);
+			m_merged_rows[m_row_offsets[row.string_idx] + row.suffix_length] = row.old_rank + i;
+		}
+	}
+	
+	
+	// Merge the given strings to the BWT of #s_1#…#s_m#$, i.e. the text
+	// produced by strings_writer, so that the result is the BWT of the same
+	// kind of text of the union of the strings. The added strings should be
+	// sorted and not contain any of the existing strings. Only rank and
+	// access are needed from the existing BWT, which is expected to have
+	// m ≥ 1. last_string is s_m. The positions of the rows are stored in
+	// row_map.
+	//
+	// The existing BWT is copied to the beginning of the output once, after
+	// which the added characters are interleaved from the end in place.
+	template <typename t_bwt>
+	void merge_bwt(
+		t_bwt const &old_bwt,
+		std::size_t const old_string_count,
+		std::uint8_t const *last_string,
+		std::size_t const last_string_length,
+		std::vector <bwt_merge_string> const &added_strings,
+		sdsl::int_vector <8> /* out */ &bwt,
+		bwt_merge_row_map /* out */ &row_map
+	)
+	{
+		assert(old_string_count);
+		auto const old_size(old_bwt.size());
+		
+		// Copy the existing BWT.
+		bwt.resize(old_size);
+		{
+			auto *bwt_bytes(reinterpret_cast <std::uint8_t *>(bwt.data()));
+			for (std::size_t i(0); i < old_size; ++i)
+				bwt_bytes[i] = old_bwt[i];
+		}
+		
+		detail::bwt_count_array starts{};
+		detail::bwt_starts(bwt, starts);
+		row_map.construct(old_bwt, starts, old_string_count, last_string, last_string_length, added_strings);
+		
+		// Resizing retains the contents.
+		auto const &rows(row_map.added_rows());
+		bwt.resize(old_size + rows.size());
+		auto *bwt_bytes(reinterpret_cast <std::uint8_t *>(bwt.data()));
+		row_map.move_rows(bwt_bytes);
+		
+		// Merge. The character that precedes the whole string is the
+		// terminator of the previous one.
+		auto const sentinel(bwt_bytes[0]);
+		std::uint64_t src_pos(old_size);
+		std::uint64_t dst_pos(bwt.size());
+		for (auto it(rows.crbegin()), end(rows.crend()); it != end; ++it)
+		{
+			auto const &row(*it);
+			std::copy_backward(bwt_bytes + row.old_rank, bwt_bytes + src_pos, bwt_bytes + dst_pos);
+			dst_pos -= src_pos - row.old_rank;
+			src_pos = row.old_rank;
+			
+			auto const &str(added_strings[row.string_idx]);
+			bwt_bytes[--dst_pos] = (row.suffix_length == str.length ? sentinel : str.data[str.length - row.suffix_length - 1]);
+		}
+		assert(src_pos == dst_pos);
+	}
+	
+	
+	// The interleaving of the rows of the BWTs of #s_1#…#s_m#$ and
+	// #t_1#…#t_n#$ where each t_j is greater than each s_i in the BWT of
+	// #s_1#…#s_m#t_1#…#t_n#$. Both are expected to have at least one string.
+	// Rank and access are needed for constructing the interleaving, after
+	// which the BWTs are only read in order to write the merged BWT, so
+	// they may be e.g. replaced with buffers of files.
+	//
+	// The rows of the latter BWT retain their order except that the rows of
+	// $ and #t_1#… are not needed. Like above, the rows of s_m are moved and
+	// then each of t_j is traversed with LF in the latter BWT and with
+	// backward search in the former to determine the interleaving.
+	class bwt_interleaving
+	{
+	protected:
+		detail::last_string_rows	m_moved_rows;
+		sdsl::bit_vector			m_is_rhs_row;
+		
+	public:
+		template <typename t_bwt>
+		void construct(
+			t_bwt const &lhs,
+			std::size_t const lhs_string_count,
+			std::uint8_t const *lhs_last_string,
+			std::size_t const lhs_last_string_length,
+			t_bwt const &rhs,
+			std::size_t const rhs_string_count
+		);
+		
+		std::uint64_t size() const { return m_is_rhs_row.size(); }
+		
+		// Append the merged BWT to dst.
+		template <typename t_lhs, typename t_rhs, typename t_dst>
+		void merge(t_lhs &lhs, t_rhs &rhs, t_dst &dst) const;
+	};
+	
+	
+	template <typename t_bwt>
+	void bwt_interleaving::construct(
+		t_bwt const &lhs,
+		std::size_t const lhs_string_count,
+		std::uint8_t const *lhs_last_string,
+		std::size_t const lhs_last_string_length,
+		t_bwt const &rhs,
+		std::size_t const rhs_string_count
+	)
+	{
+		assert(lhs_string_count);
+		assert(rhs_string_count);
+		
+		auto const lhs_size(lhs.size());
+		auto const rhs_size(rhs.size());
+		auto const sentinel(lhs[0]);
+		
+		detail::bwt_count_array lhs_starts{};
+		detail::bwt_count_array rhs_starts{};
+		detail::bwt_starts(lhs, lhs_starts);
+		detail::bwt_starts(rhs, rhs_starts);
+		
+		m_moved_rows.locate(lhs, lhs_starts, lhs_string_count, lhs_last_string, lhs_last_string_length);
+		
+		// Mark the rows that come from the latter BWT. Since the order of
+		// its rows does not change, the position of a row is the number of
+		// smaller rows in the former BWT plus the number of its own rows
+		// that are smaller.
+		sdsl::bit_vector is_rhs_row(lhs_size + rhs_size - 2, 0);
+		for (std::size_t i(0); i < rhs_string_count; ++i)
+		{
+			// The terminator of t_n precedes $ in the merged text and comes
+			// first, the other terminators come after those of the former
+			// BWT. Skip the row of #t_1#… when counting the rows of the
+			// latter BWT.
+			bool const is_last(1 + i == rhs_string_count);
+			std::uint64_t rhs_row(is_last ? 1 : 3 + i);
+			std::uint64_t lhs_rank(is_last ? 1 : 2 + lhs_string_count);
+			
+			while (true)
+			{
+				is_rhs_row[lhs_rank + rhs_row - (1 == rhs_row ? 1 : 2)] = 1;
+				
+				auto const c(rhs[rhs_row]);
+				if (sentinel == c)
+					break;
+				
+				rhs_row = rhs_starts[c] + rhs.rank(rhs_row, c);
+				lhs_rank = lhs_starts[c] + m_moved_rows.rank(lhs, lhs_rank, c);
+			}
+		}
+		
+		m_is_rhs_row.swap(is_rhs_row);
+	}
+	
+	
+	template <typename t_lhs, typename t_rhs, typename t_dst>
+	void bwt_interleaving::merge(t_lhs &lhs, t_rhs &rhs, t_dst &dst) const
+	{
+		// The rows of the former BWT are read in the moved order, which
+		// differs from the original one only inside the groups of the last
+		// string. Row 0 of the latter BWT is that of $ and row 2 that of
+		// #t_1#…, neither of which is needed.
+		std::uint64_t lhs_pos(0);
+		std::uint64_t rhs_pos(1);
+		for (std::uint64_t i(0), size(m_is_rhs_row.size()); i < size; ++i)
+		{
+			if (m_is_rhs_row[i])
+			{
+				dst.push_back(rhs[rhs_pos++]);
+				if (2 == rhs_pos)
+					++rhs_pos;
+			}
+			else
+			{
+				dst.push_back(lhs[m_moved_rows.original_row(lhs_pos++)]);
+			}
+		}
+		
+		assert(lhs_pos == lhs.size());
+		assert(rhs_pos == rhs.size());
+	}
+}
+
+#endif
@@ -14,12 +14,22 @@
  along with this program.  If not, see http://www.gnu.org/licenses/ .
  */
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <dispatch/dispatch.h>
+#include <exception>
+#include <mutex>
 #include <range/v3/all.hpp>
 #include <sdsl/bits.hpp>
 #include <sdsl/csa_wt.hpp>
 #include <sdsl/int_vector.hpp>
 #include <sdsl/suffix_array_algorithm.hpp>
 #include <sdsl/wt_algorithm.hpp>
+#include <tribble/dispatch_fn.hh>
+#include <tribble/small_alphabet_wt.hh>
+#include <type_traits>
+#include <vector>
 #include "find_superstring.hh"
 #include "linked_list.hh"
 #include "string_array.hh"
@@ -27,10 +37,6 @@
 
 namespace tribble { namespace detail {
 	
-	typedef wt_type::size_type wt_size_type;
-	typedef wt_type::value_type wt_value_type;
-	
-	
 	struct bwt_range
 	{
 		size_type left{0};
@@ -44,7 +50,8 @@ namespace tribble { namespace detail {
 		{
 		}
 		
-		bwt_range(cst_type const &cst, cst_type::node_type const &node):
+		template <typename t_cst>
+		bwt_range(t_cst const &cst, node_type const &node):
 			bwt_range(cst.lb(node), cst.rb(node))
 		{
 		}
@@ -53,7 +60,8 @@ namespace tribble { namespace detail {
 		inline bool operator==(bwt_range const &other) const { return (left == other.left && right == other.right); }
 		inline size_type count() const { return 1 + (right - left); }
 		
-		inline char next_leftmost_character(csa_type const &csa) const
+		template <typename t_csa>
+		inline char next_leftmost_character(t_csa const &csa) const
 		{
 			return csa.bwt[left];
 		}
@@ -64,13 +72,15 @@ namespace tribble { namespace detail {
 			right = val;
 		}
 		
-		inline void lf(csa_type const &csa)
+		template <typename t_csa>
+		inline void lf(t_csa const &csa)
 		{
 			auto const lf_val(csa.lf[left]); // FIXME: check exact time.
 			set_range_singular(lf_val);
 		}
 		
-		inline size_type backward_search(csa_type const &csa, csa_type::char_type c)
+		template <typename t_csa>
+		inline size_type backward_search(t_csa const &csa, typename t_csa::char_type c)
 		{
 			return sdsl::backward_search(csa, left, right, c, left, right);
 		}
@@ -80,73 +90,198 @@ namespace tribble { namespace detail {
 	struct range_pair
 	{
 		bwt_range substring_range;
-		cst_type::node_type match_range;
+		node_type match_range;
 		
 		range_pair() = default;
 		
-		range_pair(bwt_range const &substring_range_, cst_type::node_type const &match_range_):
+		range_pair(bwt_range const &substring_range_, node_type const &match_range_):
 			substring_range(substring_range_),
 			match_range(match_range_)
 		{
 		}
 		
 		inline size_type substring_count() const { return substring_range.count(); }
-		inline size_type match_count(cst_type const &cst) const { return cst.size(match_range); }
-		inline size_type substring_lb(cst_type const &cst) const { return substring_range.left; }
-		inline size_type substring_rb(cst_type const &cst) const { return substring_range.right; }
+		template <typename t_cst>
+		inline size_type match_count(t_cst const &cst) const { return cst.size(match_range); }
+		template <typename t_cst>
+		inline size_type substring_lb(t_cst const &cst) const { return substring_range.left; }
+		template <typename t_cst>
+		inline size_type substring_rb(t_cst const &cst) const { return substring_range.right; }
 		inline void get_substring_range(bwt_range &target) const { target = substring_range; /* Copy */ }
-		inline void get_match_range(cst_type::node_type &target) const { target = match_range; /* Copy */ }
+		inline void get_match_range(node_type &target) const { target = match_range; /* Copy */ }
 		
-		inline char next_substring_leftmost_character(cst_type const &cst) const
+		template <typename t_cst>
+		inline char next_substring_leftmost_character(t_cst const &cst) const
 		{
 			return substring_range.next_leftmost_character(cst.csa);
 		}
 		
-		inline bool has_equal_ranges(cst_type const &cst) const
+		template <typename t_cst>
+		inline bool has_equal_ranges(t_cst const &cst) const
 		{
 			bwt_range temp(cst, match_range);
 			return temp == substring_range;
 		}
 		
-		inline void substring_lf(cst_type const &cst)
+		template <typename t_cst>
+		inline void substring_lf(t_cst const &cst)
 		{
 			substring_range.lf(cst.csa);
 		}
 		
-		inline size_type backward_search_substring(cst_type const &cst, char const character)
+		template <typename t_cst>
+		inline size_type backward_search_substring(t_cst const &cst, char const character)
 		{
 			return substring_range.backward_search(cst.csa, character);
 		}
 		
-		inline size_type backward_search_match(cst_type const &cst, char const character)
+		template <typename t_cst>
+		inline size_type backward_search_match(t_cst const &cst, char const character)
 		{
 			match_range = cst.wl(match_range, character);
 			return cst.size(match_range);
 		}
 		
-		inline bool check_match_suffix_link(cst_type const &cst, cst_type::node_type const &expected)
+		template <typename t_cst>
+		inline bool check_match_suffix_link(t_cst const &cst, node_type const &expected)
 		{
-			cst_type::node_type actual_target = cst.sl(match_range); // Takes O(rr_enclose + log σ) time.
+			node_type actual_target = cst.sl(match_range); // Takes O(rr_enclose + log σ) time.
 			return (actual_target == expected);
 		}
 	};
 	
 	
+	struct found_match
+	{
+		size_type	idx{0};
+		node_type	matching_node{};
+		size_type	matching_suffix_length{0};
+		
+		found_match() = default;
+		
+		found_match(size_type const idx_, node_type const &matching_node_, size_type const matching_suffix_length_):
+			idx(idx_),
+			matching_node(matching_node_),
+			matching_suffix_length(matching_suffix_length_)
+		{
+		}
+	};
+	
+	
+	// A range that remains to be handled by branch_checker. For ranges that
+	// may contain non-unique strings, length is the current length; for
+	// ranges of unique strings, it is the matching suffix length.
+	struct branch_checker_work_item
+	{
+		enum item_type : std::uint8_t
+		{
+			NON_UNIQUE_STRINGS,
+			UNIQUE_SUBSTRINGS
+		};
+		
+		range_pair	ranges;
+		size_type	length{0};
+		size_type	branching_suffix_length{0};
+		item_type	type{NON_UNIQUE_STRINGS};
+		
+		branch_checker_work_item() = default;
+		
+		branch_checker_work_item(
+			item_type const type_,
+			range_pair const &ranges_,
+			size_type const length_,
+			size_type const branching_suffix_length_
+		):
+			ranges(ranges_),
+			length(length_),
+			branching_suffix_length(branching_suffix_length_),
+			type(type_)
+		{
+		}
+	};
+	
+	
+	// Buffers used by one task. The matches are collected here since
+	// string_array packs the values of adjacent strings into the same words.
+	// The work stack is reused for all the ranges handled by the task.
+	struct branch_checker_task_state
+	{
+		sdsl::int_vector <>							rank_c_i;
+		sdsl::int_vector <>							rank_c_j;
+		std::vector <found_match>					matches;
+		std::vector <branch_checker_work_item>		work_stack;
+		
+		branch_checker_task_state(std::size_t const sigma, std::uint8_t const width):
+			rank_c_i(sigma, 0, width),
+			rank_c_j(sigma, 0, width)
+		{
+		}
+	};
+	
+	
+	template <typename t_cst>
 	class branch_checker
 	{
+	protected:
+		typedef t_cst									cst_type;
+		typedef typename cst_type::csa_type				csa_type;
+		typedef typename csa_type::wavelet_tree_type	wt_type;
+		typedef typename wt_type::size_type				wt_size_type;
+		typedef typename wt_type::value_type			wt_value_type;
+		typedef branch_checker_task_state				task_state;
+		typedef branch_checker_work_item				work_item;
+		
+		enum { MATCH_BUFFER_SIZE = 4096 };
+		
+		// Wait for the tasks of the group to finish and release it also when
+		// the calling thread leaves the scope with an exception, since the
+		// tasks refer to the checker.
+		class group_guard
+		{
+		protected:
+			dispatch_group_t	&m_group;
+			
+		public:
+			group_guard(dispatch_group_t &group):
+				m_group(group)
+			{
+				m_group = dispatch_group_create();
+			}
+			
+			~group_guard()
+			{
+				dispatch_group_wait(m_group, DISPATCH_TIME_FOREVER);
+				dispatch_release(m_group);
+				m_group = nullptr;
+			}
+		};
+		
 	protected:
 		string_array			m_strings;
 		range_pair				m_initial_range_pair;
-		sdsl::int_vector <>		m_rank_c_i;
-		sdsl::int_vector <>		m_rank_c_j;
+		std::mutex				m_strings_mutex;
+		std::mutex				m_exception_mutex;
+		std::exception_ptr		m_exception{};
+		std::atomic_bool		m_failed{false};
+		dispatch_group_t		m_group{};
+		size_type				m_task_threshold{0};
 		cst_type const			*m_cst{nullptr};
 		wt_type const			*m_wt{nullptr};
+		string_sample_map const	*m_string_samples{nullptr};
+		std::uint8_t			m_rank_width{0};
 		char const				m_sentinel{0};
 		
 	public:
-		branch_checker(cst_type const &cst, char const sentinel, sdsl::int_vector <> const &string_lengths):
+		branch_checker(
+			cst_type const &cst,
+			char const sentinel,
+			sdsl::int_vector <> const &string_lengths,
+			string_sample_map const &string_samples,
+			std::size_t const thread_count
+		):
 			m_cst(&cst),
 			m_wt(&cst.csa.wavelet_tree),
+			m_string_samples(&string_samples),
 			m_sentinel(sentinel)
 		{
 			// Sentinel may not be '\0'.
@@ -193,19 +328,18 @@ namespace tribble { namespace detail {
 				// Set the initial range for locating branch points and non-uniques.
 				{
 					// Include the range for “#$” for backward_search.
-					cst_type::node_type const root(cst.root());
+					node_type const root(cst.root());
 					range_pair temp(sentinel_range, root);
 					m_initial_range_pair = std::move(temp);
 				}
 				
-				// Prepare the reusable buffers for interval_symbols.
-				{
-					auto const sigma(m_wt->sigma);
-					m_rank_c_i.width(bits_for_n);
-					m_rank_c_j.width(bits_for_n);
-					m_rank_c_i.resize(sigma);
-					m_rank_c_j.resize(sigma);
-				}
+				// Set the width of the buffers for interval_symbols.
+				m_rank_width = bits_for_n;
+				
+				// Handle ranges of at least this many strings in separate tasks.
+				// The limit was chosen somewhat arbitrarily to have several tasks
+				// for each thread while keeping their number manageable.
+				m_task_threshold = std::max(size_type(4096), string_count / (16 * std::max(std::size_t(1), thread_count)));
 			}
 		}
 		
@@ -218,11 +352,158 @@ namespace tribble { namespace detail {
 		
 		
 	protected:
+		inline task_state make_task_state() const
+		{
+			return task_state(m_wt->sigma, m_rank_width);
+		}
+		
+		
+		// Store the matches found by a task.
+		void flush_matches(task_state &state)
+		{
+			std::lock_guard <std::mutex> lock(m_strings_mutex);
+			for (auto const &match : state.matches)
+			{
+				string_type string;
+				m_strings.get(match.idx, string);
+				assert(string.sa_idx == 2 + match.idx);
+				string.is_unique = true;
+				string.matching_node = match.matching_node;
+				string.matching_suffix_length = match.matching_suffix_length;
+				m_strings.set(match.idx, string);
+			}
+			state.matches.clear();
+		}
+		
+		
+		// Add a range to the work stack. Handle ranges of at least
+		// m_task_threshold strings in a new task instead.
+		void push_work_item(task_state &state, work_item const &item)
+		{
+			if (item.ranges.substring_count() < m_task_threshold)
+			{
+				state.work_stack.push_back(item);
+				return;
+			}
+			
+			dispatch_queue_t queue(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+			dispatch_group_async_fn(m_group, queue, [this, item](){
+				// Exceptions may not be thrown through libdispatch, so store
+				// the first one and rethrow it after the group has finished.
+				try
+				{
+					if (m_failed)
+						return;
+					
+					auto state(make_task_state());
+					state.work_stack.push_back(item);
+					process_work_stack(state);
+					flush_matches(state);
+				}
+				catch (...)
+				{
+					store_exception(std::current_exception());
+				}
+			});
+		}
+		
+		
+		void store_exception(std::exception_ptr const &exc)
+		{
+			std::lock_guard <std::mutex> lock_guard(m_exception_mutex);
+			if (!m_exception)
+				m_exception = exc;
+			m_failed = true;
+		}
+		
+		
+		// Sort the items added since first_idx by decreasing size, so that the
+		// smallest range is handled first and the largest one last. Since the
+		// other ranges are at most half the size of their parent range, the
+		// stack contains O(σ log n) items.
+		void sort_work_items(task_state &state, std::size_t const first_idx)
+		{
+			auto &stack(state.work_stack);
+			std::sort(stack.begin() + first_idx, stack.end(), [](work_item const &lhs, work_item const &rhs){
+				return lhs.ranges.substring_count() > rhs.ranges.substring_count();
+			});
+		}
+		
+		
+		// Handle the ranges in the work stack until it is empty.
+		void process_work_stack(task_state &state)
+		{
+			auto &stack(state.work_stack);
+			while (!stack.empty() && !m_failed)
+			{
+				auto const item(stack.back());
+				stack.pop_back();
+				
+				switch (item.type)
+				{
+					case work_item::NON_UNIQUE_STRINGS:
+						check_non_unique_strings <false>(state, item.ranges, item.length);
+						break;
+						
+					case work_item::UNIQUE_SUBSTRINGS:
+						add_match_for_unique_substrings(
+							state,
+							item.ranges.match_range,
+							item.ranges.substring_range,
+							item.length,
+							item.branching_suffix_length
+						);
+						break;
+						
+					default:
+						assert(0);
+						break;
+				}
+			}
+		}
+		
+		
 		void list_next_substring_characters(
+			task_state &state,
 			bwt_range const &range,
 			wt_value_type *cs_ptr,
 			wt_size_type /* out */ &symbol_count
 		)
+		{
+			list_next_substring_characters(state, range, cs_ptr, symbol_count, is_small_alphabet_wt <wt_type>());
+		}
+		
+		
+		// The flat representation of small_alphabet_wt determines the ranks of
+		// all symbols at once and lists the symbols in lexicographic order, so
+		// the ranks fit on the stack and sorting is not needed.
+		void list_next_substring_characters(
+			task_state &state,
+			bwt_range const &range,
+			wt_value_type *cs_ptr,
+			wt_size_type /* out */ &symbol_count,
+			std::true_type
+		)
+		{
+			if (!m_wt->is_flat())
+			{
+				list_next_substring_characters(state, range, cs_ptr, symbol_count, std::false_type());
+				return;
+			}
+			
+			std::array <wt_size_type, wt_type::MAX_SIGMA> rank_c_i;
+			std::array <wt_size_type, wt_type::MAX_SIGMA> rank_c_j;
+			m_wt->interval_symbols(range.left, 1 + range.right, symbol_count, cs_ptr, rank_c_i, rank_c_j);
+		}
+		
+		
+		void list_next_substring_characters(
+			task_state &state,
+			bwt_range const &range,
+			wt_value_type *cs_ptr,
+			wt_size_type /* out */ &symbol_count,
+			std::false_type
+		)
 		{
 			sdsl::interval_symbols(
 				*m_wt,
@@ -230,8 +511,8 @@ namespace tribble { namespace detail {
 				1 + range.right,
 				symbol_count,
 				cs_ptr,
-				m_rank_c_i,
-				m_rank_c_j
+				state.rank_c_i,
+				state.rank_c_j
 			);
 			
 			// FIXME: for some reason cs is not lexicographically ordered even though the wavelet tree is balanced.
@@ -241,8 +522,8 @@ namespace tribble { namespace detail {
 				auto range(ranges::view::take_exactly(
 					ranges::view::zip(
 						cs_range,
-						m_rank_c_i,
-						m_rank_c_j
+						state.rank_c_i,
+						state.rank_c_j
 					),
 					symbol_count
 				));
@@ -255,7 +536,8 @@ namespace tribble { namespace detail {
 
 		
 		void add_match(
-			cst_type::node_type const &matching_node,
+			task_state &state,
+			node_type const &matching_node,
 			size_type const suffix_branch_point,
 			size_type const matching_suffix_length,
 			size_type const branching_suffix_length
@@ -274,20 +556,10 @@ namespace tribble { namespace detail {
 					<< std::endl;
 			}
 			
-			// Find the end of the substring that contains branch_point.
-			size_type end_sa_idx(suffix_branch_point);
-			for (std::size_t i(0); i < branching_suffix_length; ++i)
-			{
-				auto const psi_val(csa.psi[end_sa_idx]); // FIXME: check the exact time.
-				end_sa_idx = psi_val;
-			}
-			
 			// Check that the lengths match.
 #ifndef NDEBUG
 			{
-				assert(m_sentinel == csa.bwt[csa.psi[end_sa_idx]]);
-
-				cst_type::node_type node(matching_node);
+				node_type node(matching_node);
 				for (std::size_t i(0); i < matching_suffix_length; ++i)
 					node = m_cst->sl(node);
 				
@@ -295,45 +567,48 @@ namespace tribble { namespace detail {
 			}
 #endif
 			
-			// Convert to start position.
-			size_type start_sa_idx(0);
-			assert(end_sa_idx <= m_initial_range_pair.substring_rb(*m_cst));
-			if (m_initial_range_pair.substring_lb(*m_cst) == end_sa_idx)
-				start_sa_idx = m_initial_range_pair.substring_rb(*m_cst);
-			else
-				start_sa_idx = end_sa_idx - 1;
-			
-			size_type const idx(start_sa_idx - 2);
+			// Find the string that contains branch_point with the samples. If the
+			// end of the substring is reached first, convert to start position.
+			size_type idx(0);
+			size_type end_sa_idx(suffix_branch_point);
+			if (!m_string_samples->find_string(csa, end_sa_idx, branching_suffix_length, idx))
+			{
+				assert(m_sentinel == csa.bwt[csa.psi[end_sa_idx]]);
+				
+				size_type start_sa_idx(0);
+				assert(end_sa_idx <= m_initial_range_pair.substring_rb(*m_cst));
+				if (m_initial_range_pair.substring_lb(*m_cst) == end_sa_idx)
+					start_sa_idx = m_initial_range_pair.substring_rb(*m_cst);
+				else
+					start_sa_idx = end_sa_idx - 1;
+				
+				idx = start_sa_idx - 2;
+			}
 			
 			// Store the values.
-			string_type string;
-			m_strings.get(idx, string);
-			assert(string.sa_idx == start_sa_idx);
-			string.is_unique = true;
-			string.matching_node = matching_node;
-			string.matching_suffix_length = matching_suffix_length;
-			m_strings.set(idx, string);
+			state.matches.emplace_back(idx, matching_node, matching_suffix_length);
+			if (MATCH_BUFFER_SIZE <= state.matches.size())
+				flush_matches(state);
 		}
 		
 		
-		template <size_type t_recursion_limit>
 		void add_match_for_unique_substrings(
-			cst_type::node_type const &match_range,
+			task_state &state,
+			node_type const &match_range,
 			bwt_range const &initial_substring_range,
 			size_type const matching_suffix_length,
 			size_type const branching_suffix_length
 		)
 		{
 			// Find the unique strings that may be extended left from initial_substring_range.
-			// When done, report them with match_range.
+			// When done, report them with match_range. Ranges of more than one string
+			// are added to the work stack.
 			
-			auto const initial_substring_count(initial_substring_range.count());
-
 			// List the next characters.
 			auto const sigma(m_wt->sigma);
 			wt_value_type cs[sigma];
 			wt_size_type symbol_count{0}, si{0};
-			list_next_substring_characters(initial_substring_range, cs, symbol_count);
+			list_next_substring_characters(state, initial_substring_range, cs, symbol_count);
 			
 			// The first character should not be '$' since the range is not [0, csa.size() - 1].
 			assert(0 != cs[si]);
@@ -342,9 +617,7 @@ namespace tribble { namespace detail {
 			if (cs[si] == m_sentinel)
 				++si;
 			
-			bwt_range remaining_range;
-			bool should_handle_remaining_range(false);
-			
+			auto const first_item_idx(state.work_stack.size());
 			while (si < symbol_count)
 			{
 				bwt_range substring_range(initial_substring_range);
@@ -357,28 +630,15 @@ namespace tribble { namespace detail {
 				auto const substring_count(substring_range.backward_search(m_cst->csa, next_character));
 				assert(substring_count);
 				
-				// Check if the current count exceeds recursion limit.
-				if (t_recursion_limit <= initial_substring_count && initial_substring_count / 2 < substring_count)
-				{
-					// There should only be one remaining_range since its size is greater than
-					// one half of the initial range.
-					assert(!should_handle_remaining_range);
-					
-					should_handle_remaining_range = true;
-					remaining_range = std::move(substring_range);
-					
-					continue;
-				}
-
-				// Recurse if there are more than one possible substring.
+				// Continue later if there are more than one possible substring.
 				if (1 != substring_count)
 				{
-					add_match_for_unique_substrings <t_recursion_limit>(
-						match_range,
-						substring_range,
+					push_work_item(state, work_item(
+						work_item::UNIQUE_SUBSTRINGS,
+						range_pair(substring_range, match_range),
 						matching_suffix_length,
 						1 + branching_suffix_length
-					);
+					));
 					continue;
 				}
 				
@@ -386,40 +646,27 @@ namespace tribble { namespace detail {
 				assert(substring_range.is_singular());
 				
 				// If there is one matching substring, report the match.
-				add_match(match_range, substring_range.left, matching_suffix_length, 1 + branching_suffix_length);
+				add_match(state, match_range, substring_range.left, matching_suffix_length, 1 + branching_suffix_length);
 			}
 			
-			// If there was a long range, handle it.
-			if (should_handle_remaining_range)
-			{
-				// Tail recursion.
-				add_match_for_unique_substrings <t_recursion_limit>(
-					match_range,
-					remaining_range,
-					matching_suffix_length,
-					1 + branching_suffix_length
-				);
-			}
+			sort_work_items(state, first_item_idx);
 		}
 		
 		
-		template <size_type t_recursion_limit, bool t_is_first_range>
-		void check_non_unique_strings(range_pair const &initial_range_pair, size_type const current_length)
+		template <bool t_is_first_range>
+		void check_non_unique_strings(task_state &state, range_pair const &initial_range_pair, size_type const current_length)
 		{
 			// List the symbols that precede the ones in initial_range. Handle the
 			// special cases where the character is either '$' (in case of t_is_first_range)
-			// or '#'. After that, recurse in case the range length is less than half of that
-			// of the initial range, or do tail recursion otherwise. If the substring range
-			// has become singular, use LF repeatedly to find the preceding character and use
+			// or '#'. After that, add the ranges of more than one string to the work stack.
+			// If the substring range has become singular, use LF repeatedly to find the preceding character and use
 			// backward_search on the match range until it becomes singular, too. If the
 			// Weiner link used to extend the match range to the left points to an implicit
 			// node, stop extending.
 			
-			auto const initial_substring_count(initial_range_pair.substring_count());
-			
 			// Smaller number of strings should be handled as a special case, which
 			// has not been written yet.
-			assert(1 < initial_substring_count);
+			assert(1 < initial_range_pair.substring_count());
 			assert(1 < initial_range_pair.match_count(*m_cst));
 			
 			// Since the alphabet in our case is small, use an array
@@ -427,7 +674,7 @@ namespace tribble { namespace detail {
 			auto const sigma(m_wt->sigma);
 			wt_value_type cs[sigma];
 			wt_size_type symbol_count{0}, si{0};
-			list_next_substring_characters(initial_range_pair.substring_range, cs, symbol_count);
+			list_next_substring_characters(state, initial_range_pair.substring_range, cs, symbol_count);
 			
 			// Handle the first range (i.e. [0, csa.size() - 1]) separately;
 			// other cases have the assertion below.
@@ -448,15 +695,13 @@ namespace tribble { namespace detail {
 				++si;
 			
 			// Proceed with the remaining characters.
-			range_pair remaining_range_pair;
-			bool should_handle_remaining_range(false);
-
+			auto const first_item_idx(state.work_stack.size());
 			while (si < symbol_count)
 			{
 				range_pair range_pair(initial_range_pair);
 				
 				// Store the previous match range before calling backward_search_match().
-				cst_type::node_type previous_match_range;
+				node_type previous_match_range;
 				range_pair.get_match_range(previous_match_range);
 
 				// Check the next character.
@@ -476,6 +721,7 @@ namespace tribble { namespace detail {
 					if (1 == range_pair.substring_count())
 					{
 						add_match(
+							state,
 							previous_match_range,
 							range_pair.substring_lb(*m_cst),
 							current_length,
@@ -484,34 +730,21 @@ namespace tribble { namespace detail {
 					}
 					else
 					{
-						add_match_for_unique_substrings <t_recursion_limit>(
-							previous_match_range,
-							range_pair.substring_range,
+						push_work_item(state, work_item(
+							work_item::UNIQUE_SUBSTRINGS,
+							::tribble::detail::range_pair(range_pair.substring_range, previous_match_range),
 							current_length,
 							1 + current_length
-						);
+						));
 					}
 					
 					continue;
 				}
 
-				// Check if the current count exceeds recursion limit.
-				if (t_recursion_limit <= initial_substring_count && initial_substring_count / 2 < substring_count)
-				{
-					// There should only be one remaining_range since its size is greater than
-					// one half of the initial range.
-					assert(!should_handle_remaining_range);
-					
-					should_handle_remaining_range = true;
-					remaining_range_pair = std::move(range_pair);
-					
-					continue;
-				}
-				
-				// Recurse if there are more than one possible substring.
+				// Continue later if there are more than one possible substring.
 				if (1 != substring_count)
 				{
-					check_non_unique_strings <t_recursion_limit, false>(range_pair, 1 + current_length);
+					push_work_item(state, work_item(work_item::NON_UNIQUE_STRINGS, range_pair, 1 + current_length, 0));
 					continue;
 				}
 				
@@ -564,6 +797,7 @@ namespace tribble { namespace detail {
 				// Since the match range became singular, we have found the branching point.
 			add_match:
 				add_match(
+					state,
 					previous_match_range,
 					range_pair.substring_lb(*m_cst),
 					1 + matching_suffix_length,
@@ -574,20 +808,36 @@ namespace tribble { namespace detail {
 				;
 			}
 			
-			// If there was a long range, handle it.
-			if (should_handle_remaining_range)
-			{
-				// Tail recursion.
-				check_non_unique_strings <t_recursion_limit, false>(remaining_range_pair, 1 + current_length);
-			}
+			sort_work_items(state, first_item_idx);
 		}
 		
 		
 	public:
 		void check_non_unique_strings()
 		{
-			// Recursion minimum limit chosen somewhat arbitrarily.
-			check_non_unique_strings <32, true>(m_initial_range_pair, 0);
+			// Nothing to do if there are less than two strings.
+			if (!m_rank_width)
+				return;
+			
+			// Handle the first range on the calling thread. Ranges of at least
+			// m_task_threshold strings are handled in tasks that may start
+			// further tasks, so wait for the group to become empty.
+			try
+			{
+				group_guard guard(m_group);
+				auto state(make_task_state());
+				check_non_unique_strings <true>(state, m_initial_range_pair, 0);
+				process_work_stack(state);
+				flush_matches(state);
+			}
+			catch (...)
+			{
+				store_exception(std::current_exception());
+			}
+			
+			// Report the first exception instead of returning partial results.
+			if (m_exception)
+				std::rethrow_exception(m_exception);
 		}
 	};
 }}
@@ -595,15 +845,69 @@ namespace tribble { namespace detail {
 
 namespace tribble {
 
+	template <typename t_cst>
 	void check_non_unique_strings(
-		cst_type const &cst,
+		t_cst const &cst,
 		sdsl::int_vector <> const &string_lengths,
+		string_sample_map const &string_samples,
 		char const sentinel,
+		std::size_t const thread_count,
 		string_array /* out */ &strings_available
 	)
 	{
-		detail::branch_checker checker(cst, sentinel, string_lengths);
+		detail::branch_checker <t_cst> checker(cst, sentinel, string_lengths, string_samples, thread_count);
 		checker.check_non_unique_strings();
 		checker.get_strings_available(strings_available);
 	}
+	
+	
+	// Instantiate for each index configuration and sampling.
+	template void check_non_unique_strings(
+		small_alphabet_index_policy <index_sampling::SPARSE>::cst_type const &,
+		sdsl::int_vector <> const &,
+		string_sample_map const &,
+		char const,
+		std::size_t const,
+		string_array &
+	);
+	template void check_non_unique_strings(
+		small_alphabet_index_policy <index_sampling::DENSE>::cst_type const &,
+		sdsl::int_vector <> const &,
+		string_sample_map const &,
+		char const,
+		std::size_t const,
+		string_array &
+	);
+	template void check_non_unique_strings(
+		huffman_index_policy <index_sampling::SPARSE>::cst_type const &,
+		sdsl::int_vector <> const &,
+		string_sample_map const &,
+		char const,
+		std::size_t const,
+		string_array &
+	);
+	template void check_non_unique_strings(
+		huffman_index_policy <index_sampling::DENSE>::cst_type const &,
+		sdsl::int_vector <> const &,
+		string_sample_map const &,
+		char const,
+		std::size_t const,
+		string_array &
+	);
+	template void check_non_unique_strings(
+		compact_index_policy <index_sampling::SPARSE>::cst_type const &,
+		sdsl::int_vector <> const &,
+		string_sample_map const &,
+		char const,
+		std::size_t const,
+		string_array &
+	);
+	template void check_non_unique_strings(
+		compact_index_policy <index_sampling::DENSE>::cst_type const &,
+		sdsl::int_vector <> const &,
+		string_sample_map const &,
+		char const,
+		std::size_t const,
+		string_array &
+	);
 }
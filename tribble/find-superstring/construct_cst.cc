@@ -0,0 +1,70 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <sdsl/int_vector_buffer.hpp>
+#include <tribble/dispatch_fn.hh>
+#include "construct_cst.hh"
+
+
+namespace {
+	
+	// The size in bytes of the buffer of each thread for reading the suffix array.
+	enum : std::uint64_t { SA_BUFFER_SIZE = 4 * 1024 * 1024 };
+}
+
+
+namespace tribble { namespace detail {
+	
+	void construct_bwt_parallel(sdsl::cache_config &config, std::size_t const thread_count)
+	{
+		// The text is accessed at random, so it is loaded, but the suffix array
+		// is read in ranges through buffers instead of copying all of it.
+		sdsl::int_vector <8> text;
+		sdsl::load_from_cache(text, sdsl::conf::KEY_TEXT, config);
+		auto const sa_fname(sdsl::cache_file_name(sdsl::conf::KEY_SA, config));
+		
+		auto const size(text.size());
+		sdsl::int_vector <8> bwt(size, 0);
+		if (size)
+		{
+			// Each thread fills a range of the BWT. The elements of
+			// int_vector <8> are bytes, so writing to different
+			// ranges is safe.
+			auto const *text_bytes(reinterpret_cast <std::uint8_t const *>(text.data()));
+			auto *bwt_bytes(reinterpret_cast <std::uint8_t *>(bwt.data()));
+			std::size_t const block_size(1 + (size - 1) / thread_count);
+			dispatch_queue_t queue(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+			dispatch_apply_fn(thread_count, queue, [&sa_fname, text_bytes, bwt_bytes, size, block_size](std::size_t const i) {
+				auto const begin(std::min(size, i * block_size));
+				auto const end(std::min(size, begin + block_size));
+				if (begin == end)
+					return;
+				
+				sdsl::int_vector_buffer <> sa(sa_fname, std::ios::in, SA_BUFFER_SIZE);
+				assert(sa.size() == size);
+				for (std::size_t j(begin); j < end; ++j)
+				{
+					std::size_t const pos(sa[j]);
+					bwt_bytes[j] = text_bytes[pos ? pos - 1 : size - 1];
+				}
+			});
+		}
+		
+		sdsl::store_to_cache(bwt, sdsl::conf::KEY_BWT, config);
+	}
+}}
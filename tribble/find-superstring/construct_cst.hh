@@ -0,0 +1,427 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_CONSTRUCT_CST_HH
+#define TRIBBLE_CONSTRUCT_CST_HH
+
+#include <iostream>
+#include <sdsl/construct.hpp>
+#include <sdsl/csa_wt.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include "timer.hh"
+
+
+namespace tribble { namespace detail {
+	
+	// Run one step of the construction and report the time taken.
+	template <typename t_fn>
+	void construction_step(std::string const &description, t_fn &&fn)
+	{
+		std::cerr << description << "…" << std::flush;
+		timer timer;
+		
+		fn();
+		
+		timer.stop();
+		std::cerr << " finished in " << timer.ms_elapsed() << " ms." << std::endl;
+	}
+	
+	
+	// Construct the BWT from the cached text and suffix array using the given
+	// number of threads. Both are loaded to memory, so this should only be used
+	// if the cache files are in SDSL's RAM file system.
+	void construct_bwt_parallel(sdsl::cache_config &config, std::size_t const thread_count);
+	
+	// The members of csa_wt in the order in which csa_wt::serialize() writes
+	// them. csa_wt has no setters for its members, so a CSA whose parts have
+	// been constructed separately is stored with this and loaded as csa_wt.
+	template <typename t_csa>
+	struct csa_wt_parts
+	{
+		typedef typename t_csa::size_type size_type;
+		
+		// Both sample types are stored as plain int_vectors.
+		static_assert(
+			std::is_base_of <sdsl::int_vector <>, typename t_csa::sa_sample_type>::value,
+			"Expected the SA samples to be stored in an int_vector."
+		);
+		static_assert(
+			std::is_base_of <sdsl::int_vector <>, typename t_csa::isa_sample_type>::value,
+			"Expected the ISA samples to be stored in an int_vector."
+		);
+		
+		typename t_csa::wavelet_tree_type	wavelet_tree;
+		sdsl::int_vector <>					sa_samples;
+		sdsl::int_vector <>					isa_samples;
+		typename t_csa::alphabet_type		alphabet;
+		
+		size_type serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name = "") const
+		{
+			sdsl::structure_tree_node *child(sdsl::structure_tree::add_child(v, name, "tribble::detail::csa_wt_parts"));
+			size_type written_bytes(0);
+			
+			written_bytes += wavelet_tree.serialize(out, child, "wavelet_tree");
+			written_bytes += sa_samples.serialize(out, child, "sa_samples");
+			written_bytes += isa_samples.serialize(out, child, "isa_samples");
+			written_bytes += alphabet.serialize(out, child, "alphabet");
+			
+			sdsl::structure_tree::add_size(child, written_bytes);
+			return written_bytes;
+		}
+	};
+	
+	
+	// Construct the wavelet tree and the alphabet of the CSA from the BWT.
+	template <typename t_csa, typename t_bwt_buffer>
+	void construct_csa_wavelet_tree(t_bwt_buffer &bwt_buf, csa_wt_parts <t_csa> &parts)
+	{
+		auto const size(bwt_buf.size());
+		if (0 == size)
+			throw std::runtime_error("Expected the BWT to be non-empty.");
+		
+		{
+			auto event(sdsl::memory_monitor::event("construct csa-alphabet"));
+			typename t_csa::alphabet_type alphabet(bwt_buf, size);
+			parts.alphabet.swap(alphabet);
+		}
+		
+		{
+			auto event(sdsl::memory_monitor::event("construct wavelet tree"));
+			typename t_csa::wavelet_tree_type wt(bwt_buf, size);
+			parts.wavelet_tree.swap(wt);
+		}
+	}
+	
+	
+	template <typename t_csa>
+	void store_csa_to_cache(csa_wt_parts <t_csa> const &parts, sdsl::cache_config &config)
+	{
+		auto event(sdsl::memory_monitor::event("Store CSA"));
+		t_csa csa;
+		sdsl::store_to_cache(parts, std::string(sdsl::conf::KEY_CSA) + "_" + sdsl::util::class_to_hash(csa), config);
+	}
+	
+	
+	// Construct the CSA from the cached BWT and store it to the cache.
+	// The SA and ISA samples are determined by traversing the text backwards
+	// with LF using the wavelet tree of the CSA, so apart from the CSA itself
+	// only the alphabet is allocated; neither the suffix array nor any other
+	// vector of the length of the text is needed.
+	template <typename t_csa>
+	void construct_csa_from_bwt(sdsl::cache_config &config)
+	{
+		const char* KEY_BWT(sdsl::key_bwt_trait <t_csa::alphabet_category::WIDTH>::KEY_BWT);
+		std::size_t const sa_sample_dens(t_csa::sa_sample_dens);
+		std::size_t const isa_sample_dens(t_csa::isa_sample_dens);
+		csa_wt_parts <t_csa> parts;
+		
+		{
+			sdsl::int_vector_buffer <t_csa::alphabet_category::WIDTH> bwt_buf(sdsl::cache_file_name(KEY_BWT, config));
+			construct_csa_wavelet_tree(bwt_buf, parts);
+			
+			// Allocate the samples as csa_wt's sampling strategies would.
+			auto const size(bwt_buf.size());
+			std::uint8_t const width(1 + sdsl::bits::hi(size));
+			parts.sa_samples.width(width);
+			parts.sa_samples.resize((size + sa_sample_dens - 1) / sa_sample_dens);
+			parts.isa_samples.width(width);
+			parts.isa_samples.resize((size - 1) / isa_sample_dens + 1);
+			
+			// Traverse the text backwards starting from the row of the
+			// terminator, which is the last character.
+			auto event(sdsl::memory_monitor::event("sample SA and ISA"));
+			auto const &wt(parts.wavelet_tree);
+			auto const &alphabet(parts.alphabet);
+			std::size_t row(0);
+			std::size_t text_pos(size - 1);
+			while (true)
+			{
+				if (0 == row % sa_sample_dens)
+					parts.sa_samples[row / sa_sample_dens] = text_pos;
+				
+				if (0 == text_pos % isa_sample_dens)
+					parts.isa_samples[text_pos / isa_sample_dens] = row;
+				
+				if (0 == text_pos)
+					break;
+				
+				auto const res(wt.inverse_select(row));
+				row = alphabet.C[alphabet.char2comp[res.second]] + res.first;
+				--text_pos;
+			}
+		}
+		
+		store_csa_to_cache(parts, config);
+	}
+	
+	
+	// Construct the CSA from the cached BWT and the given SA and ISA samples,
+	// which are expected to have been allocated as above, and store it to
+	// the cache.
+	template <typename t_csa>
+	void construct_csa_from_bwt(sdsl::cache_config &config, sdsl::int_vector <> &sa_samples, sdsl::int_vector <> &isa_samples)
+	{
+		const char* KEY_BWT(sdsl::key_bwt_trait <t_csa::alphabet_category::WIDTH>::KEY_BWT);
+		csa_wt_parts <t_csa> parts;
+		
+		{
+			sdsl::int_vector_buffer <t_csa::alphabet_category::WIDTH> bwt_buf(sdsl::cache_file_name(KEY_BWT, config));
+			auto const size(bwt_buf.size());
+			if (sa_samples.size() != (size + t_csa::sa_sample_dens - 1) / t_csa::sa_sample_dens)
+				throw std::runtime_error("Unexpected number of SA samples.");
+			if (size && isa_samples.size() != (size - 1) / t_csa::isa_sample_dens + 1)
+				throw std::runtime_error("Unexpected number of ISA samples.");
+			
+			construct_csa_wavelet_tree(bwt_buf, parts);
+		}
+		
+		parts.sa_samples.swap(sa_samples);
+		parts.isa_samples.swap(isa_samples);
+		store_csa_to_cache(parts, config);
+	}
+	
+	
+	// Check that the sentinel is lexicographically smaller than the other
+	// characters of the text.
+	template <typename t_cst>
+	void check_sentinel(t_cst const &cst, char const sentinel)
+	{
+		auto const comp_val(cst.csa.char2comp[sentinel]);
+		if (1 != comp_val)
+		{
+			std::stringstream output;
+			output
+			<< "The text contains the character '"
+			<< std::hex << cst.csa.comp2char[1]
+			<< "' the lexicographic value is less than that of the sentinel, '"
+			<< std::hex << static_cast <int>(sentinel)
+			<< "'.";
+			
+			throw std::runtime_error(output.str());
+		}
+	}
+	
+	
+	// Construct the CST.
+	// Based on SDSL's construct in construct.hpp. If the text has already been
+	// stored to the cache, the file will not be read. Each step is timed, and
+	// the suffix array and the BWT are constructed using the given number of
+	// threads where possible.
+	template <typename t_index>
+	void construct(
+		t_index &idx,
+		std::string const &file,
+		sdsl::cache_config &config,
+		uint8_t const num_bytes,
+		bool const build_lcp,
+		std::size_t const thread_count
+	)
+	{
+		auto event(sdsl::memory_monitor::event("Construct CST"));
+		const char* KEY_TEXT(sdsl::key_text_trait <t_index::alphabet_category::WIDTH>::KEY_TEXT);
+		const char* KEY_BWT(sdsl::key_bwt_trait <t_index::alphabet_category::WIDTH>::KEY_BWT);
+		typedef sdsl::int_vector <t_index::alphabet_category::WIDTH> text_type;
+		
+		{
+			// (1) Check if the compressed suffix array is cached.
+			typename t_index::csa_type csa;
+			if (!cache_file_exists(std::string(sdsl::conf::KEY_CSA) + "_" + sdsl::util::class_to_hash(csa), config))
+			{
+				// Based on SDSL's construct for csa_tag.
+				sdsl::cache_config csa_config(false, config.dir, config.id, config.file_map);
+				
+				{
+					// (1.1) Check if the text is cached.
+					auto event(sdsl::memory_monitor::event("Parse input text"));
+					if (!sdsl::cache_file_exists(KEY_TEXT, csa_config))
+					{
+						construction_step("Reading the text", [&file, &csa_config, num_bytes, KEY_TEXT](){
+							text_type text;
+							sdsl::load_vector_from_file(text, file, num_bytes);
+							if (sdsl::contains_no_zero_symbol(text, file))
+							{
+								sdsl::append_zero_symbol(text);
+								sdsl::store_to_cache(text, KEY_TEXT, csa_config);
+							}
+						});
+					}
+					sdsl::register_cache_file(KEY_TEXT, csa_config);
+				}
+				
+				{
+					// (1.2) Check if the suffix array is cached. libdivsufsort
+					// uses OpenMP if it has been enabled.
+					auto event(sdsl::memory_monitor::event("SA"));
+					if (!sdsl::cache_file_exists(sdsl::conf::KEY_SA, csa_config))
+					{
+						std::stringstream description;
+						description << "Constructing the suffix array";
+#ifdef _OPENMP
+						description << " using " << thread_count << " threads";
+#endif
+						construction_step(description.str(), [&csa_config](){
+							sdsl::construct_sa <t_index::alphabet_category::WIDTH>(csa_config);
+						});
+					}
+					sdsl::register_cache_file(sdsl::conf::KEY_SA, csa_config);
+				}
+				
+				{
+					// (1.3) Check if the BWT is cached.
+					auto event(sdsl::memory_monitor::event("BWT"));
+					if (!sdsl::cache_file_exists(KEY_BWT, csa_config))
+					{
+						bool const sa_in_ram(sdsl::is_ram_file(sdsl::cache_file_name(sdsl::conf::KEY_SA, csa_config)));
+						if (8 == t_index::alphabet_category::WIDTH && 1 < thread_count && sa_in_ram)
+						{
+							std::stringstream description;
+							description << "Constructing the BWT using " << thread_count << " threads";
+							construction_step(description.str(), [&csa_config, thread_count](){
+								construct_bwt_parallel(csa_config, thread_count);
+							});
+						}
+						else
+						{
+							construction_step("Constructing the BWT", [&csa_config](){
+								sdsl::construct_bwt <t_index::alphabet_category::WIDTH>(csa_config);
+							});
+						}
+					}
+					sdsl::register_cache_file(KEY_BWT, csa_config);
+				}
+				
+				construction_step("Constructing the CSA", [&csa, &csa_config](){
+					// (1.4) Use the BWT to construct the CSA.
+					auto event(sdsl::memory_monitor::event("Construct CSA"));
+					typename t_index::csa_type tmp(csa_config);
+					csa.swap(tmp);
+				});
+				
+				auto event(sdsl::memory_monitor::event("Store CSA"));
+				config.file_map = csa_config.file_map;
+				sdsl::store_to_cache(csa, std::string(sdsl::conf::KEY_CSA) + "_" + sdsl::util::class_to_hash(csa), config);
+			}
+			sdsl::register_cache_file(std::string(sdsl::conf::KEY_CSA) + "_" + sdsl::util::class_to_hash(csa), config);
+		}
+		
+		{
+			// (2) Check if the longest common prefix array is cached.
+			// cst_sct3 uses this for BP construction.
+			auto event(sdsl::memory_monitor::event("LCP"));
+			sdsl::register_cache_file(KEY_TEXT, config);
+			sdsl::register_cache_file(KEY_BWT, config);
+			sdsl::register_cache_file(sdsl::conf::KEY_SA, config);
+			
+			if (!sdsl::cache_file_exists(sdsl::conf::KEY_LCP, config))
+			{
+				construction_step("Constructing the LCP array", [&config](){
+					if (t_index::alphabet_category::WIDTH==8)
+						sdsl::construct_lcp_semi_extern_PHI(config);
+					else
+						sdsl::construct_lcp_PHI<t_index::alphabet_category::WIDTH>(config);
+				});
+			}
+			sdsl::register_cache_file(sdsl::conf::KEY_LCP, config);
+		}
+		
+		construction_step("Constructing the CST", [&idx, &config, build_lcp](){
+			auto event(sdsl::memory_monitor::event("CST"));
+			if (build_lcp)
+			{
+				t_index tmp(config);
+				tmp.swap(idx);
+			}
+			else
+			{
+				t_index tmp(config, true, false);
+				tmp.swap(idx);
+			}
+		});
+		
+		if (config.delete_files)
+		{
+			auto event(sdsl::memory_monitor::event("Delete temporary files"));
+			sdsl::util::delete_all_files(config.file_map);
+		}
+	}
+	
+	
+	// Construct the CST from the cached BWT without the text or the full
+	// suffix array. The CSA is constructed unless it has been cached. The LCP
+	// array is constructed from the BWT.
+	template <typename t_index>
+	void construct_cst_from_bwt(sdsl::cache_config &config, bool const build_lcp, t_index &idx)
+	{
+		auto event(sdsl::memory_monitor::event("Construct CST from BWT"));
+		typedef typename t_index::csa_type csa_type;
+		static_assert(8 == t_index::alphabet_category::WIDTH, "Only byte alphabets are supported.");
+		const char* KEY_BWT(sdsl::key_bwt_trait <t_index::alphabet_category::WIDTH>::KEY_BWT);
+		
+		if (!sdsl::cache_file_exists(KEY_BWT, config))
+			throw std::runtime_error("Expected the BWT to be cached.");
+		sdsl::register_cache_file(KEY_BWT, config);
+		
+		{
+			// (1) Check if the CSA is cached.
+			auto event(sdsl::memory_monitor::event("Construct CSA"));
+			csa_type csa;
+			if (!sdsl::cache_file_exists(std::string(sdsl::conf::KEY_CSA) + "_" + sdsl::util::class_to_hash(csa), config))
+			{
+				construction_step("Constructing the CSA", [&config](){
+					construct_csa_from_bwt <csa_type>(config);
+				});
+			}
+			sdsl::register_cache_file(std::string(sdsl::conf::KEY_CSA) + "_" + sdsl::util::class_to_hash(csa), config);
+		}
+		
+		{
+			// (2) Construct the LCP array using the BWT.
+			auto event(sdsl::memory_monitor::event("LCP"));
+			if (!sdsl::cache_file_exists(sdsl::conf::KEY_LCP, config))
+			{
+				construction_step("Constructing the LCP array", [&config](){
+					sdsl::construct_lcp_bwt_based(config);
+				});
+			}
+			sdsl::register_cache_file(sdsl::conf::KEY_LCP, config);
+		}
+		
+		construction_step("Constructing the CST", [&idx, &config, build_lcp](){
+			auto event(sdsl::memory_monitor::event("CST"));
+			if (build_lcp)
+			{
+				t_index tmp(config);
+				tmp.swap(idx);
+			}
+			else
+			{
+				t_index tmp(config, true, false);
+				tmp.swap(idx);
+			}
+		});
+		
+		if (config.delete_files)
+		{
+			auto event(sdsl::memory_monitor::event("Delete temporary files"));
+			sdsl::util::delete_all_files(config.file_map);
+		}
+	}
+}}
+
+#endif
@@ -17,97 +17,138 @@
 #include <algorithm>
 #include <boost/iostreams/device/file_descriptor.hpp>
 #include <boost/iostreams/stream.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fcntl.h>
 #include <iostream>
+#include <limits>
 #include <sdsl/io.hpp>
-#include <tribble/fasta_reader.hh>
-#include <tribble/line_reader.hh>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <tribble/io.hh>
+#include <tribble/mapped_file.hh>
 #include <unistd.h>
+#include "bcr.hh"
+#include "construct_cst.hh"
 #include "find_superstring.hh"
+#include "packed_strings.hh"
+#include "read_sequences.hh"
+#include "sequence_run.hh"
+#include "sequence_store.hh"
+#include "string_sort.hh"
+#include "strings_writer.hh"
 #include "timer.hh"
 
+#ifdef _OPENMP
+#	include <omp.h>
+#endif
+
 namespace ios = boost::iostreams;
 
 
 namespace tribble { namespace detail {
 
-// FIXME: re-indent.
-
-// Construct the CST.
-// Based on SDSL's construct in construct.hpp.
-	template <typename t_index>
-	void construct(t_index &idx, std::string const &file, uint8_t const num_bytes)
+	class create_index_cb
 	{
-		auto event(sdsl::memory_monitor::event("Construct CST"));
-		sdsl::cache_config config;
-		const char* KEY_TEXT(sdsl::key_text_trait <t_index::alphabet_category::WIDTH>::KEY_TEXT);
-		const char* KEY_BWT(sdsl::key_bwt_trait <t_index::alphabet_category::WIDTH>::KEY_BWT);
-		sdsl::csa_tag csa_t;
+	public:
+		typedef vector_source::vector_type vector_type;
 		
+	protected:
+		enum : std::size_t {
+			MAX_MERGE_FAN_IN		= 256,
+			MIN_MERGE_BUFFER_SIZE	= 64 * 1024
+		};
+		
+	protected:
+		std::ostream &m_index_stream;
+		std::ostream &m_strings_stream;
+		char const *m_strings_fname{};
+		sequence_store m_sequences;
+		std::vector <string_sort_item> m_sorted_sequences;
+		std::vector <sequence_run> m_runs;
+		strings_writer m_sorted_input_writer;
+		std::vector <std::uint8_t> m_previous_seq;
+		timer m_read_timer{};
+		std::size_t m_memory_budget{0};
+		std::size_t m_thread_count{1};
+		std::size_t m_shard_count{1};
+		enum_strings_format m_strings_format{strings_format_arg_plain};
+		enum_index_construction m_index_construction{index_construction_arg_SA};
+		index_tag m_index_tag{};
+		char m_sentinel{};
+		uint32_t m_seqno{0};
+		bool m_input_is_sorted{false};
+
+	protected:
+		void report_sequence()
 		{
-			// (1) Check if the compressed suffix array is cached.
-			typename t_index::csa_type csa;
-			if (!cache_file_exists(std::string(sdsl::conf::KEY_CSA) + "_" + sdsl::util::class_to_hash(csa), config))
-			{
-				sdsl::cache_config csa_config(false, config.dir, config.id, config.file_map);
-				sdsl::construct(csa, file, csa_config, num_bytes, csa_t);
-				auto event(sdsl::memory_monitor::event("Store CSA"));
-				config.file_map = csa_config.file_map;
-				sdsl::store_to_cache(csa, std::string(sdsl::conf::KEY_CSA) + "_" + sdsl::util::class_to_hash(csa), config);
-			}
-			sdsl::register_cache_file(std::string(sdsl::conf::KEY_CSA) + "_" + sdsl::util::class_to_hash(csa), config);
+			++m_seqno;
+			if (0 == m_seqno % 10000)
+				std::cerr << " " << m_seqno << std::flush;
 		}
 		
+		void report_line(uint32_t const lineno)
 		{
-			// (2) Check if the longest common prefix array is cached.
-			// cst_sct3 uses this for BP construction.
-			auto event(sdsl::memory_monitor::event("LCP"));
-			sdsl::register_cache_file(KEY_TEXT, config);
-			sdsl::register_cache_file(KEY_BWT, config);
-			sdsl::register_cache_file(sdsl::conf::KEY_SA, config);
-			
-			if (!sdsl::cache_file_exists(sdsl::conf::KEY_LCP, config))
-			{
-				if (t_index::alphabet_category::WIDTH==8)
-					sdsl::construct_lcp_semi_extern_PHI(config);
-				else
-					sdsl::construct_lcp_PHI<t_index::alphabet_category::WIDTH>(config);
-			}
-			sdsl::register_cache_file(sdsl::conf::KEY_LCP, config);
+			if (0 == lineno % 10000)
+				std::cerr << " " << lineno << std::flush;
 		}
 		
+		// The soft limit of the number of open files.
+		static inline std::size_t open_file_limit()
 		{
-			auto event(sdsl::memory_monitor::event("CST"));
-			t_index tmp(config, true, false);
-			tmp.swap(idx);
+			struct rlimit limit;
+			if (0 == getrlimit(RLIMIT_NOFILE, &limit) && RLIM_INFINITY != limit.rlim_cur)
+				return limit.rlim_cur;
+			return std::numeric_limits <std::size_t>::max();
 		}
 		
-		if (config.delete_files)
+		// Memory needed for the sequences and their sort handles after adding a sequence of the given length.
+		inline std::size_t memory_usage_after_adding(std::size_t const seq_length) const
 		{
-			auto event(sdsl::memory_monitor::event("Delete temporary files"));
-			sdsl::util::delete_all_files(config.file_map);
+			return m_sequences.memory_usage_after_adding(seq_length) + (1 + m_sequences.size()) * sizeof(string_sort_item);
 		}
-	}
-
 		
-	class create_index_cb
-	{
-	public:
-		typedef vector_source::vector_type vector_type;
+		// Write a sequence of sorted input directly to the strings file
+		// after checking that it does not precede the previous one.
+		void write_sorted_input_seq(std::uint8_t const *data, std::size_t const seq_length)
+		{
+			if (m_sorted_input_writer.string_count())
+			{
+				auto const *previous(m_previous_seq.data());
+				auto const previous_length(m_previous_seq.size());
+				if (!sequence_less(previous, previous_length, data, seq_length))
+				{
+					// Skip duplicates.
+					if (previous_length == seq_length && 0 == std::memcmp(previous, data, seq_length))
+						return;
+					
+					std::stringstream output;
+					output << "The input is not sorted; the sequence that follows unique string "
+						<< m_sorted_input_writer.string_count() << " precedes it.";
+					throw std::runtime_error(output.str());
+				}
+			}
+			
+			m_sorted_input_writer.add(data, seq_length);
+			m_previous_seq.assign(data, data + seq_length);
+		}
 		
-	protected:
-		std::ostream &m_index_stream;
-		std::ostream &m_strings_stream;
-		char const *m_strings_fname{};
-		std::vector <vector_type> m_sequences;
-		timer m_read_timer{};
-		char m_sentinel{};
-		uint32_t m_seqno{0};
-
-	protected:
-		void handle_sentinel_in_text()
+		void copy_seq(std::uint8_t const *data, std::size_t const seq_length)
 		{
-			throw std::runtime_error("The text contains the sentinel character.");
+			if (m_input_is_sorted)
+			{
+				write_sorted_input_seq(data, seq_length);
+				return;
+			}
+			
+			// Write a sorted run first if the memory budget would be exceeded.
+			if (m_memory_budget && !m_sequences.empty() && m_memory_budget < memory_usage_after_adding(seq_length))
+				write_run();
+			
+			// Copy the sequence to the collection.
+			m_sequences.push_back(data, seq_length);
 		}
 		
 		void copy_seq(
@@ -116,210 +157,487 @@ namespace tribble { namespace detail {
 			vector_source &vs
 		)
 		{
-			// Copy the sequence to the collection.
-			vector_type seq_copy;
-			seq_copy.resize(seq_length);
-			std::copy_n(seq->begin(), seq_length, seq_copy.begin());
-			m_sequences.emplace_back(seq_copy);
+			// This is safe because the element width is 8.
+			copy_seq(reinterpret_cast <std::uint8_t const *>(seq->data()), seq_length);
 			vs.put_vector(seq);
 		}
-
 		
-	public:
-		create_index_cb(std::ostream &index_stream, std::ostream &strings_stream, char const *strings_fname, char const sentinel):
-			m_index_stream(index_stream),
-			m_strings_stream(strings_stream),
-			m_strings_fname(strings_fname),
-			m_sentinel(sentinel)
+		void sort_sequences()
 		{
-			assert(m_strings_fname);
+			// Sort handles to the sequences instead of the sequences themselves.
+			auto const sorter(make_string_sorter([this](std::size_t const idx) {
+				return m_sequences[idx];
+			}, m_thread_count));
+			sorter.sort(m_sequences.size(), m_sorted_sequences);
 		}
 		
-		// For FASTA.
-		void handle_sequence(
-			std::string const &identifier,
-			std::unique_ptr <vector_type> &seq,
-			std::size_t const seq_length,
-			vector_source &vs
-		)
+		// Pass the unique sequences in sorted order to the given function.
+		template <typename t_fn>
+		void for_each_unique_sequence(t_fn &&fn)
 		{
-			copy_seq(seq, seq_length, vs);
-			++m_seqno;
-
-			if (0 == m_seqno % 10000)
-				std::cerr << " " << m_seqno << std::flush;
+			bool has_previous(false);
+			std::size_t previous_idx(0);
+			for (auto const &item : m_sorted_sequences)
+			{
+				auto const idx(item.idx());
+				if (has_previous && m_sequences.is_equal(idx, previous_idx))
+					continue;
+				
+				auto const seq(m_sequences[idx]);
+				fn(seq.first, seq.second);
+				previous_idx = idx;
+				has_previous = true;
+			}
 		}
 		
-		// For line-oriented text.
-		void handle_sequence(
-			uint32_t const lineno,
-			std::unique_ptr <vector_type> &seq,
-			std::size_t const seq_length,
-			vector_source &vs
-		)
+		// Estimate the memory needed for constructing the CST from a text of
+		// the given size when the cache files are kept in RAM. In addition to
+		// the text, the suffix array is constructed with 64-bit values and
+		// the bit-compressed suffix array and LCP values are cached. The
+		// BWT is constructed after the 64-bit values have been freed and
+		// needs a copy of the text and the BWT in addition to the cached
+		// files, since the suffix array is read through buffers.
+		static inline std::size_t ram_construction_memory(std::size_t const text_size)
 		{
-			copy_seq(seq, seq_length, vs);
-
-			if (0 == lineno % 10000)
-				std::cerr << " " << lineno << std::flush;
+			auto const bits(1 + sdsl::bits::hi(text_size));
+			return text_size * (1 + sizeof(std::uint64_t)) + 2 * text_size * bits / 8;
 		}
-
-		void finish()
+		
+		// Construct the CST from the text using SDSL's suffix array construction.
+		template <typename t_cst>
+		void construct_cst_sa(sdsl::int_vector <8> &text, t_cst &cst)
 		{
-			assert(m_sentinel);
+			// Keep the intermediate files in SDSL's RAM file system if the text
+			// is in memory and the construction fits in the memory budget.
+			// Otherwise read the text from the strings file and write the
+			// cache files to the working directory.
+			bool const use_ram_cache(
+				!text.empty() &&
+				(0 == m_memory_budget || ram_construction_memory(text.size()) <= m_memory_budget)
+			);
+			sdsl::cache_config config(true, use_ram_cache ? "@" : "./");
+			if (use_ram_cache)
+				sdsl::store_to_cache(text, sdsl::conf::KEY_TEXT, config);
 			
 			{
-				m_read_timer.stop();
-				std::cerr << " finished in " << m_read_timer.ms_elapsed() << " ms, read " << m_sequences.size() << " sequences." << std::endl;
+				decltype(text) empty;
+				text.swap(empty);
 			}
 			
-			std::cerr << "Sorting the sequences…" << std::flush;
+			// Construct with LCP if assertions have been enabled.
+			::tribble::detail::construct(cst, m_strings_fname, config, 1, TRIBBLE_ASSERTIONS_ENABLED, m_thread_count);
+		}
+		
+		// Construct the BWT of the text with BCR and the CST from the BWT.
+		template <typename t_cst>
+		void construct_cst_bcr(sdsl::int_vector <8> &text, sdsl::int_vector <> const &string_lengths, t_cst &cst)
+		{
+			if (1 < m_shard_count)
+			{
+				// The shards copy their parts of the text from the mapped
+				// strings file, so the text does not need to be kept in memory.
+				{
+					decltype(text) empty;
+					text.swap(empty);
+				}
+				
+				mapped_file strings_file;
+				open_file_for_reading(m_strings_fname, strings_file);
+				if (strings_file.size() && std::memchr(strings_file.data(), 0, strings_file.size()))
+					throw std::runtime_error("The text contains the zero character.");
+				
+				// Shards are used for limiting the memory use, so write the merged
+				// BWT and the other cache files to the working directory unless
+				// the construction fits in the memory budget.
+				bool const use_ram_cache(m_memory_budget && ram_construction_memory(1 + strings_file.size()) <= m_memory_budget);
+				sdsl::cache_config config(true, use_ram_cache ? "@" : "./");
+				auto const bwt_fname(sdsl::cache_file_name(sdsl::conf::KEY_BWT, config));
+				
+				std::stringstream message;
+				message << "Constructing the BWT with BCR in " << m_shard_count << " shards";
+				construction_step(message.str(), [this, &strings_file, &string_lengths, &bwt_fname](){
+					construct_bwt_bcr_sharded(
+						reinterpret_cast <std::uint8_t const *>(strings_file.data()),
+						strings_file.size(),
+						string_lengths,
+						m_sentinel,
+						m_shard_count,
+						m_thread_count,
+						m_strings_fname,
+						bwt_fname
+					);
+				});
+				
+				strings_file.close();
+				
+				// Construct with LCP if assertions have been enabled.
+				construct_cst_from_bwt(config, TRIBBLE_ASSERTIONS_ENABLED, cst);
+				return;
+			}
+			
+			sdsl::int_vector <8> bwt;
+			if (text.empty())
+			{
+				construction_step("Reading the text", [this, &text](){
+					sdsl::load_vector_from_file(text, m_strings_fname, 1);
+					if (!sdsl::contains_no_zero_symbol(text, m_strings_fname))
+						throw std::runtime_error("The text contains the zero character.");
+					sdsl::append_zero_symbol(text);
+				});
+			}
+			
+			construction_step("Constructing the BWT with BCR", [this, &text, &string_lengths, &bwt](){
+				construct_bwt_bcr(text, string_lengths.size(), m_sentinel, bwt);
+			});
+			
+			{
+				decltype(text) empty;
+				text.swap(empty);
+			}
+			
+			// Use the memory budget as above.
+			bool const use_ram_cache(0 == m_memory_budget || ram_construction_memory(bwt.size()) <= m_memory_budget);
+			sdsl::cache_config config(true, use_ram_cache ? "@" : "./");
+			sdsl::store_to_cache(bwt, sdsl::conf::KEY_BWT, config);
+			
+			{
+				decltype(bwt) empty;
+				bwt.swap(empty);
+			}
+			
+			// Construct with LCP if assertions have been enabled.
+			construct_cst_from_bwt(config, TRIBBLE_ASSERTIONS_ENABLED, cst);
+		}
+		
+		// Construct the CST with the index configuration given as the policy and write the index.
+		template <typename t_policy>
+		void construct_and_serialize_index(sdsl::int_vector <8> &text, sdsl::int_vector <> &string_lengths)
+		{
+			std::cerr << "Creating the CST using at most " << m_thread_count << " threads." << std::endl;
+			typename t_policy::cst_type cst;
 			{
 				timer timer;
+
+				// Shards are only supported by BCR.
+				if (index_construction_arg_BCR == m_index_construction || 1 < m_shard_count)
+					construct_cst_bcr(text, string_lengths, cst);
+				else
+					construct_cst_sa(text, cst);
 				
-				std::sort(m_sequences.begin(), m_sequences.end());
+				if (!TRIBBLE_ASSERTIONS_ENABLED && !cst.lcp.empty())
+					throw std::runtime_error("Expected LCP to be empty.");
+				
+				check_sentinel(cst, m_sentinel);
 				
 				timer.stop();
-				std::cerr << " finished in " << timer.ms_elapsed() << " ms." << std::endl;
+				std::cerr << "Created the CST in " << timer.ms_elapsed() << " ms." << std::endl;
 			}
 			
-			std::cerr << "Writing to the strings file…" << std::flush;
-			auto string_count(m_sequences.size());
-			if (string_count)
+			string_sample_map string_samples;
+			construction_step("Sampling the string indices", [this, &cst, &string_lengths, &string_samples](){
+				string_samples.construct(cst.csa, m_sentinel, string_lengths.size(), TRIBBLE_STRING_SAMPLES);
+			});
+			
+			// Serialize.
+			std::cerr << "Serializing…" << std::flush;
 			{
 				timer timer;
 
-				// Output the first sequence.
-				decltype(m_sequences)::value_type const *previous_seq(&m_sequences[0]);
-				m_strings_stream << m_sentinel;
+				index_type <t_policy> index(cst, string_lengths, string_samples, m_sentinel);
+				sdsl::serialize(index, m_index_stream);
 				
+				timer.stop();
+				std::cerr << " finished in " << timer.ms_elapsed() << " ms." << std::endl;
+			}
+		}
+		
+		// Replace the contents of the strings file with the packed strings.
+		// The plain strings are needed for constructing the index, so this
+		// has to be done afterwards.
+		void pack_strings()
+		{
+			std::cerr << "Packing the strings…" << std::flush;
+			timer timer;
+			
+			packed_strings strings;
+			{
+				mapped_file plain_strings;
+				open_file_for_reading(m_strings_fname, plain_strings);
+				strings.build(plain_strings.data(), plain_strings.size(), m_sentinel);
+			}
+			
+			// Write to a uniquely named temporary file next to the strings file
+			// and replace the plain strings with it. Remove the temporary file
+			// on failure so that it does not affect later runs.
+			{
+				std::string packed_fname(std::string(m_strings_fname) + ".packed.XXXXXX");
+				int const fd(mkstemp(&packed_fname[0]));
+				if (-1 == fd)
+					throw std::runtime_error("Unable to create a temporary file for the packed strings.");
+				
+				try
 				{
-					auto const begin(previous_seq->begin());
-					auto const end(previous_seq->end());
-					
-					if (end != std::find(begin, end, m_sentinel))
-						handle_sentinel_in_text();
-					
-					std::copy(begin, end, std::ostream_iterator <char>(m_strings_stream));
-				}
-
-				// Output the remaining unique sequences.
-				std::size_t unique_count(1);
-				for (auto it(1 + m_sequences.begin()), end(m_sequences.end()); it != end; ++it)
-				{
-					auto &seq(*it); // Returns a reference.
-					
-					// Check uniqueness.
-					if (seq == *previous_seq)
 					{
-						--string_count;
+						file_ostream stream;
+						stream.open(ios::file_descriptor_sink(fd, ios::close_handle));
 						
-						// Set a placeholder.
-						vector_type empty;
-						seq = std::move(empty);
-						assert(0 == seq.size());
-					}
-					else
-					{
-						auto const begin(seq.begin());
-						auto const end(seq.end());
-						
-						// Check for the sentinel.
-						if (end != std::find(begin, end, m_sentinel))
-							handle_sentinel_in_text();
+						// mkstemp creates the file readable by the owner only,
+						// so retain the permissions of the plain strings file.
+						struct stat sb;
+						if (-1 == stat(m_strings_fname, &sb) || -1 == fchmod(fd, sb.st_mode & 07777))
+							throw std::runtime_error("Unable to set the permissions of the packed strings file.");
 						
-						// Write the sequence to the specified file.
-						m_strings_stream << m_sentinel;
-						std::copy(begin, end, std::ostream_iterator <char>(m_strings_stream));
-						previous_seq = &seq;
-						
-						++unique_count;
+						strings.serialize(stream);
+						stream.flush();
+						if (!stream)
+							throw std::runtime_error("Unable to write the packed strings.");
 					}
+					
+					if (0 != std::rename(packed_fname.c_str(), m_strings_fname))
+						throw std::runtime_error("Unable to replace the strings file with the packed strings.");
 				}
+				catch (...)
+				{
+					unlink(packed_fname.c_str());
+					throw;
+				}
+			}
+			
+			timer.stop();
+			std::cerr << " finished in " << timer.ms_elapsed() << " ms." << std::endl;
+		}
+		
+		// Sort the sequences read so far and write them to a temporary file.
+		void write_run()
+		{
+			sort_sequences();
+			
+			sequence_run run;
+			run.open(m_strings_fname);
+			for_each_unique_sequence([&run](std::uint8_t const *data, std::size_t const length) {
+				run.write(data, length);
+			});
+			run.finish_writing();
+			m_runs.emplace_back(std::move(run));
+			
+			// Keep the buffers for the next run.
+			m_sequences.clear();
+			m_sorted_sequences.clear();
+		}
+		
+		void write_sorted_sequences(strings_writer &writer)
+		{
+			std::cerr << "Sorting the sequences…" << std::flush;
+			{
+				timer timer;
 				
-				// Output the final sentinel.
-				m_strings_stream << m_sentinel;
-				m_strings_stream.flush();
+				sort_sequences();
 				
 				timer.stop();
-				std::cerr << " finished in " << timer.ms_elapsed() << " ms, found " << unique_count << " unique strings." << std::endl;
+				std::cerr << " finished in " << timer.ms_elapsed() << " ms." << std::endl;
 			}
-
-			// Read the sequence from the file.
-			std::cerr << "Creating the CST…" << std::flush;
-			cst_type cst;
+			
+			std::cerr << "Writing to the strings file…" << std::flush;
 			{
 				timer timer;
-
-				// Construct with LCP if assertions have been enabled.
-				if (TRIBBLE_ASSERTIONS_ENABLED)
-					::sdsl::construct(cst, m_strings_fname, 1);
-				else
+				
+				for_each_unique_sequence([&writer](std::uint8_t const *data, std::size_t const length) {
+					writer.add(data, length);
+				});
+				
+				// Free the memory.
 				{
-					::tribble::detail::construct(cst, m_strings_fname, 1);
-					if (!cst.lcp.empty())
-						throw std::runtime_error("Expected LCP to be empty.");
+					decltype(m_sorted_sequences) empty_sorted;
+					m_sequences.free();
+					m_sorted_sequences.swap(empty_sorted);
 				}
 				
-				// Check the sentinel.
-				auto const comp_val(cst.csa.char2comp[m_sentinel]);
-				if (1 != comp_val)
+				timer.stop();
+				std::cerr << " finished in " << timer.ms_elapsed() << " ms, found " << writer.string_count() << " unique strings." << std::endl;
+			}
+		}
+		
+		void merge_runs(strings_writer &writer)
+		{
+			// Handle the remaining sequences.
+			std::cerr << "Sorting the remaining sequences…" << std::flush;
+			{
+				timer timer;
+				
+				write_run();
 				{
-					std::stringstream output;
-					output
-					<< "The text contains the character '"
-					<< std::hex << cst.csa.comp2char[1]
-					<< "' the lexicographic value is less than that of the sentinel, '"
-					<< std::hex << static_cast <int>(m_sentinel)
-					<< "'.";
-					
-					throw std::runtime_error(output.str());
+					decltype(m_sorted_sequences) empty_sorted;
+					m_sequences.free();
+					m_sorted_sequences.swap(empty_sorted);
 				}
 				
 				timer.stop();
 				std::cerr << " finished in " << timer.ms_elapsed() << " ms." << std::endl;
 			}
 			
-			// List the string lengths.
-			std::cerr << "Creating other data structures…" << std::flush;
-			sdsl::int_vector <> string_lengths;
+			std::cerr << "Merging " << m_runs.size() << " sorted runs to the strings file…" << std::flush;
 			{
 				timer timer;
-
-				decltype(string_lengths)::size_type max_length(0);
-				for (auto const &seq : m_sequences)
-					max_length = std::max(max_length, seq.size());
 				
-				std::size_t const width(1 + sdsl::bits::hi(max_length));
-				string_lengths.width(width);
-				string_lengths.resize(string_count);
-				
-				std::size_t i(0);
-				for (auto const &seq : m_sequences)
+				// Allocate the string lengths beforehand and divide the rest of the
+				// budget between the buffers of the runs that are merged at once
+				// and the output. The number of runs merged at once is limited by
+				// the minimum buffer size and the number of open files.
+				std::size_t string_count(0);
+				std::size_t max_length(0);
+				for (auto const &run : m_runs)
 				{
-					auto const size(seq.size());
-					if (size)
-					{
-						string_lengths[i] = size;
-						++i;
-					}
+					string_count += run.string_count();
+					max_length = std::max(max_length, run.max_length());
 				}
+				writer.reserve(string_count, max_length);
+				
+				auto const length_memory(strings_writer::length_memory(string_count, max_length));
+				auto const buffer_memory(length_memory < m_memory_budget ? m_memory_budget - length_memory : 0);
+				auto const buffer_count(buffer_memory / MIN_MERGE_BUFFER_SIZE);	// Including the output.
+				auto const max_fan_in(std::max(std::size_t(2), std::min({
+					std::size_t(MAX_MERGE_FAN_IN),
+					(buffer_count ? buffer_count - 1 : 0),
+					open_file_limit() / 2
+				})));
+				auto const buffer_size(std::max(
+					std::size_t(MIN_MERGE_BUFFER_SIZE),
+					buffer_memory / (1 + std::min(max_fan_in, m_runs.size()))
+				));
+				merge_sequence_runs(m_runs, max_fan_in, buffer_size, m_strings_fname, writer);
+				m_runs.clear();
 				
 				timer.stop();
-				std::cerr << " finished in " << timer.ms_elapsed() << " ms." << std::endl;
+				std::cerr << " finished in " << timer.ms_elapsed() << " ms, found " << writer.string_count() << " unique strings." << std::endl;
 			}
+		}
+		
+	public:
+		create_index_cb(
+			std::ostream &index_stream,
+			std::ostream &strings_stream,
+			char const *strings_fname,
+			char const sentinel,
+			bool const input_is_sorted,
+			enum_strings_format const strings_format,
+			enum_index_construction const index_construction,
+			index_tag const &tag,
+			std::size_t const memory_budget,
+			std::size_t const thread_count,
+			std::size_t const shard_count
+		):
+			m_index_stream(index_stream),
+			m_strings_stream(strings_stream),
+			m_strings_fname(strings_fname),
+			m_sorted_input_writer(strings_stream, sentinel),
+			m_memory_budget(memory_budget),
+			m_thread_count(thread_count),
+			m_shard_count(shard_count),
+			m_strings_format(strings_format),
+			m_index_construction(index_construction),
+			m_index_tag(tag),
+			m_sentinel(sentinel),
+			m_input_is_sorted(input_is_sorted)
+		{
+			assert(m_strings_fname);
+		}
+		
+		// For FASTA.
+		void handle_sequence(
+			std::string const &identifier,
+			std::unique_ptr <vector_type> &seq,
+			std::size_t const seq_length,
+			vector_source &vs
+		)
+		{
+			copy_seq(seq, seq_length, vs);
+			report_sequence();
+		}
+		
+		// For FASTA in a mapped file.
+		void handle_sequence(
+			std::string const &identifier,
+			std::uint8_t const *data,
+			std::size_t const seq_length
+		)
+		{
+			copy_seq(data, seq_length);
+			report_sequence();
+		}
+		
+		// For line-oriented text.
+		void handle_sequence(
+			uint32_t const lineno,
+			std::unique_ptr <vector_type> &seq,
+			std::size_t const seq_length,
+			vector_source &vs
+		)
+		{
+			copy_seq(seq, seq_length, vs);
+			report_line(lineno);
+		}
+		
+		// For line-oriented text in a mapped file.
+		void handle_sequence(
+			uint32_t const lineno,
+			std::uint8_t const *data,
+			std::size_t const seq_length
+		)
+		{
+			copy_seq(data, seq_length);
+			report_line(lineno);
+		}
 
-			// Serialize.
-			std::cerr << "Serializing…" << std::flush;
+		void finish()
+		{
+			assert(m_sentinel);
+			
 			{
-				timer timer;
-
-				index_type index(cst, string_lengths, m_sentinel);
-				sdsl::serialize(index, m_index_stream);
+				m_read_timer.stop();
+				std::cerr << " finished in " << m_read_timer.ms_elapsed() << " ms";
+				if (m_input_is_sorted)
+					std::cerr << ", wrote " << m_sorted_input_writer.string_count() << " unique strings." << std::endl;
+				else if (m_runs.empty())
+					std::cerr << ", read " << m_sequences.size() << " sequences." << std::endl;
+				else
+					std::cerr << ", wrote " << m_runs.size() << " sorted runs." << std::endl;
+			}
+			
+			// Sort the sequences, remove duplicates and write the strings file.
+			// Build the text in memory unless the memory budget was exceeded,
+			// in which case merge the sorted runs instead. Sorted input has
+			// already been written, and the text is read from the strings file.
+			sdsl::int_vector <> string_lengths;
+			sdsl::int_vector <8> text;
+			if (m_input_is_sorted)
+			{
+				m_sorted_input_writer.finish(string_lengths);
 				
-				timer.stop();
-				std::cerr << " finished in " << timer.ms_elapsed() << " ms." << std::endl;
+				decltype(m_previous_seq) empty;
+				m_previous_seq.swap(empty);
 			}
+			else if (m_runs.empty())
+			{
+				auto const expected_size(2 + m_sequences.size() + m_sequences.total_length());
+				strings_writer writer(m_strings_stream, m_sentinel, text, expected_size);
+				write_sorted_sequences(writer);
+				writer.finish(string_lengths);
+			}
+			else
+			{
+				strings_writer writer(m_strings_stream, m_sentinel);
+				merge_runs(writer);
+				writer.finish(string_lengths);
+			}
+			
+			// Construct and serialize the index with the selected configuration and sampling.
+			dispatch_index_configuration(m_index_tag, [this, &text, &string_lengths](auto const &policy){
+				typedef std::decay_t <decltype(policy)> policy_type;
+				construct_and_serialize_index <policy_type>(text, string_lengths);
+			});
+			
+			if (strings_format_arg_packed == m_strings_format)
+				pack_strings();
 		}
 	};
 }}
@@ -328,39 +646,33 @@ namespace tribble { namespace detail {
 namespace tribble {
 
 	void create_index(
-		std::istream &source_stream,
+		std::vector <std::string> const &source_fnames,
 		std::ostream &index_stream,
 		std::ostream &strings_stream,
 		char const *strings_fname,
 		enum_source_format const source_format,
+		bool const input_is_sorted,
+		enum_strings_format const strings_format,
+		enum_index_construction const index_construction,
+		index_tag const &tag,
 		char const sentinel,
+		std::size_t const memory_budget,
+		std::size_t const thread_count,
+		std::size_t const shard_count,
 		error_handler &error_handler
 	)
 	{
 		try
 		{
+#ifdef _OPENMP
+			// Used by libdivsufsort.
+			omp_set_num_threads(thread_count);
+#endif
+			
 			// Read the sequence from input and create the index in the callback.
 			std::cerr << "Reading the sequences…" << std::flush;
-			vector_source vs(1, false);
-			detail::create_index_cb cb(index_stream, strings_stream, strings_fname, sentinel);
-
-			if (source_format_arg_FASTA == source_format)
-			{
-				fasta_reader <detail::create_index_cb> reader;
-				reader.read_from_stream(source_stream, vs, cb);
-			}
-			else if (source_format_arg_text == source_format)
-			{
-				line_reader <detail::create_index_cb> reader;
-				reader.read_from_stream(source_stream, vs, cb);
-			}
-			else
-			{
-				std::stringstream output;
-				output << "Unexpected source file format '" << source_format << "'.";
-
-				throw std::runtime_error(output.str());
-			}
+			detail::create_index_cb cb(index_stream, strings_stream, strings_fname, sentinel, input_is_sorted, strings_format, index_construction, tag, memory_budget, thread_count, shard_count);
+			read_sequences(source_fnames, source_format, thread_count, cb);
 		}
 		catch (std::exception const &exc)
 		{
@@ -20,6 +20,7 @@
 #include "find_superstring.hh"
 #include "linked_list.hh"
 #include "string_array.hh"
+#include "string_cache.hh"
 #include "timer.hh"
 
 namespace ios = boost::iostreams;
@@ -30,8 +31,9 @@ namespace {
 	// FIXME: not needed?
 	//typedef ios::stream <ios::file_descriptor_source> source_stream_type;
 
+	template <typename t_cst>
 	void find_suffixes_with_sorted(
-		tribble::cst_type const &cst,
+		t_cst const &cst,
 		char const sentinel,
 		tribble::string_array &strings,
 		tribble::find_superstring_match_callback &match_callback
@@ -89,7 +91,7 @@ namespace {
 				}
 				
 				// Get the corresponding suffix tree node.
-				tribble::cst_type::node_type matching_node;
+				tribble::node_type matching_node;
 				string.get_matching_node(matching_node);
 				
 				// Try to follow the Weiner link.
@@ -126,48 +128,40 @@ namespace {
 
 
 namespace tribble {
-
-	void find_suffixes(
-		std::istream &index_stream,
+	
+	template <typename t_index>
+	void find_suffixes_with_index(
+		t_index const &index,
 		std::istream &strings_stream,
+		char const *cache_fname,
+		std::uint64_t const index_size,
+		std::uint64_t const index_hash,
+		std::size_t const thread_count,
 		find_superstring_match_callback &cb
 	)
 	{
+		string_array strings_available;
+		sdsl::bit_vector is_unique_sa_order;
+		
+		// The strings only depend on the index, so try to reuse the ones
+		// written on a previous run.
+		bool cache_loaded(false);
+		if (cache_fname)
 		{
-			index_type index;
-			string_array strings_available;
-			sdsl::bit_vector is_unique_sa_order;
-
-			// Load the index.
-			std::cerr << "Loading the index…" << std::flush;
-			{
-				auto const event(sdsl::memory_monitor::event("Load index"));
-				timer timer;
-				
-				index.load(index_stream);
-				
-				if (TRIBBLE_ASSERTIONS_ENABLED && !index.index_contains_debugging_information)
-				{
-					throw std::runtime_error(
-						"find-superstring was built with assertions enabled "
-						"but the given index does not contain "
-						" the necessary data structures."
-					);
-				}
-				else if (!TRIBBLE_ASSERTIONS_ENABLED && index.index_contains_debugging_information)
-				{
-					std::cerr
-					<< std::endl
-					<< "WARNING: find-superstring was built with assertions disabled "
-					<< "but the given index contains additional data structures for "
-					<< "assertions. Memory usage information will not be accurate."
-					<< std::endl;
-				}
-				
-				timer.stop();
-				std::cerr << " finished in " << timer.ms_elapsed() << " ms." << std::endl;
-			}
+			std::cerr << "Loading the string cache…" << std::flush;
+			timer timer;
 			
+			cache_loaded = load_string_cache(cache_fname, index_size, index_hash, strings_available, is_unique_sa_order);
+			
+			timer.stop();
+			if (cache_loaded)
+				std::cerr << " finished in " << timer.ms_elapsed() << " ms." << std::endl;
+			else
+				std::cerr << " not found or out of date." << std::endl;
+		}
+		
+		if (!cache_loaded)
+		{
 			if (DEBUGGING_OUTPUT)
 			{
 				auto const &csa(index.cst.csa);
@@ -188,7 +182,7 @@ namespace tribble {
 				auto const event(sdsl::memory_monitor::event("Check non-unique strings and find match starting positions"));
 				timer timer;
 				
-				check_non_unique_strings(index.cst, index.string_lengths, index.sentinel, strings_available);
+				check_non_unique_strings(index.cst, index.string_lengths, index.string_samples, index.sentinel, thread_count, strings_available);
 				assert(std::is_sorted(
 					strings_available.cbegin(),
 					strings_available.cend(),
@@ -223,28 +217,116 @@ namespace tribble {
 				std::cerr << " finished in " << timer.ms_elapsed() << " ms." << std::endl;
 			}
 			
-			std::cerr << "Matching prefixes and suffixes…" << std::flush;
+			if (cache_fname)
 			{
-				auto const event(sdsl::memory_monitor::event("Match strings"));
+				std::cerr << "Writing the string cache…" << std::flush;
 				timer timer;
 				
-				cb.set_substring_count(strings_available.size());
-				cb.set_is_unique_vector(is_unique_sa_order);
-				cb.set_alphabet(index.cst.csa.alphabet);
-				cb.set_strings_stream(strings_stream);
-				cb.set_sentinel_character(index.sentinel);
+				if (store_string_cache(cache_fname, index_size, index_hash, strings_available, is_unique_sa_order))
+				{
+					timer.stop();
+					std::cerr << " finished in " << timer.ms_elapsed() << " ms." << std::endl;
+				}
+				else
+				{
+					std::cerr
+					<< std::endl
+					<< "WARNING: Unable to write the string cache to '" << cache_fname << "'."
+					<< std::endl;
+				}
+			}
+		}
+		
+		std::cerr << "Matching prefixes and suffixes…" << std::flush;
+		{
+			auto const event(sdsl::memory_monitor::event("Match strings"));
+			timer timer;
+			
+			cb.set_substring_count(strings_available.size());
+			cb.set_is_unique_vector(is_unique_sa_order);
+			cb.set_alphabet(index.cst.csa.alphabet);
+			cb.set_strings_stream(strings_stream);
+			cb.set_sentinel_character(index.sentinel);
 
-				find_suffixes_with_sorted(
-					index.cst,
-					index.sentinel,
-					strings_available,
-					cb
-				);
-				
+			find_suffixes_with_sorted(
+				index.cst,
+				index.sentinel,
+				strings_available,
+				cb
+			);
+			
+			timer.stop();
+			std::cerr << " finished in " << timer.ms_elapsed() << " ms." << std::endl;
+		}
+	}
+	
+
+	void find_suffixes(
+		std::istream &index_stream,
+		std::istream &strings_stream,
+		char const *cache_fname,
+		std::size_t const thread_count,
+		find_superstring_match_callback &cb
+	)
+	{
+		// Identify the index for the string cache before reading from it.
+		std::uint64_t index_size(0);
+		std::uint64_t index_hash(0);
+		if (cache_fname)
+		{
+			std::cerr << "Hashing the index…" << std::flush;
+			timer timer;
+			
+			if (hash_index(index_stream, index_size, index_hash))
+			{
 				timer.stop();
 				std::cerr << " finished in " << timer.ms_elapsed() << " ms." << std::endl;
 			}
+			else
+			{
+				std::cerr << std::endl << "WARNING: The string cache is only used with a memory-mapped index." << std::endl;
+				cache_fname = nullptr;
+			}
 		}
+		
+		// Dispatch by the index configuration.
+		auto const tag(read_index_header(index_stream));
+		dispatch_index_configuration(tag, [&](auto const &policy){
+			typedef std::decay_t <decltype(policy)> policy_type;
+			index_type <policy_type> index;
+			
+			// Load the index.
+			std::cerr << "Loading the index…" << std::flush;
+			{
+				auto const event(sdsl::memory_monitor::event("Load index"));
+				timer timer;
+				
+				index.load(index_stream);
+				
+				if (TRIBBLE_ASSERTIONS_ENABLED && !index.index_contains_debugging_information)
+				{
+					throw std::runtime_error(
+						"find-superstring was built with assertions enabled "
+						"but the given index does not contain "
+						" the necessary data structures."
+					);
+				}
+				else if (!TRIBBLE_ASSERTIONS_ENABLED && index.index_contains_debugging_information)
+				{
+					std::cerr
+					<< std::endl
+					<< "WARNING: find-superstring was built with assertions disabled "
+					<< "but the given index contains additional data structures for "
+					<< "assertions. Memory usage information will not be accurate."
+					<< std::endl;
+				}
+				
+				timer.stop();
+				std::cerr << " finished in " << timer.ms_elapsed() << " ms." << std::endl;
+			}
+			
+			find_suffixes_with_index(index, strings_stream, cache_fname, index_size, index_hash, thread_count, cb);
+		});
 
 		std::cerr << "Building the final superstring…" << std::flush;
 		{
@@ -18,20 +18,32 @@
 #ifndef TRIBBLE_FIND_SUPERSTRING_HH
 #define TRIBBLE_FIND_SUPERSTRING_HH
 
+#include <cstdint>
 #include <istream>
 #include <sdsl/cst_sct3.hpp>
-#include "cmdline.h" // For enum_source_format
+#include <sdsl/rrr_vector.hpp>
+#include <sdsl/wt_huff.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "cmdline.h" // For enum_source_format, enum_strings_format, enum_index_construction
+#include "string_sample_map.hh"
+#include <tribble/small_alphabet_wt.hh>
 
 
-// Make some CST operations faster when building with assertions.
+// Make some CST operations faster when building with assertions. The SA
+// sampling given here is only the default; it may be selected when creating
+// the index.
 #ifdef NDEBUG
-#	define TRIBBLE_ASSERTIONS_ENABLED	(0)
-#	define TRIBBLE_SA_SAMPLES			(1 << 20)
-#	define TRIBBLE_ISA_SAMPLES			(1 << 20)
+#	define TRIBBLE_ASSERTIONS_ENABLED		(0)
+#	define TRIBBLE_DEFAULT_INDEX_SAMPLING	(::tribble::index_sampling::SPARSE)
+#	define TRIBBLE_STRING_SAMPLES			(32)
 #else
-#	define TRIBBLE_ASSERTIONS_ENABLED	(1)
-#	define TRIBBLE_SA_SAMPLES			(4)
-#	define TRIBBLE_ISA_SAMPLES			(4)
+#	define TRIBBLE_ASSERTIONS_ENABLED		(1)
+#	define TRIBBLE_DEFAULT_INDEX_SAMPLING	(::tribble::index_sampling::DENSE)
+#	define TRIBBLE_STRING_SAMPLES			(4)
 #endif
 
 #ifndef DEBUGGING_OUTPUT
@@ -44,35 +56,177 @@
 #	define expensive_assert(x) ((void)0)
 #endif
 
-#define INDEX_VERSION 1
+#define INDEX_VERSION 6
 
 
 namespace tribble {
 
-	typedef sdsl::wt_hutu <>												wt_type;
-	typedef sdsl::csa_wt <wt_type, TRIBBLE_SA_SAMPLES, TRIBBLE_ISA_SAMPLES>	csa_type;
-	typedef sdsl::lcp_support_tree2 <256>									lcp_support_type;
-	typedef sdsl::cst_sct3 <csa_type, lcp_support_type>						cst_type;
-	typedef csa_type::size_type												size_type;
-	typedef csa_type::alphabet_type											alphabet_type;
+	typedef sdsl::int_vector <>::size_type									size_type;
+	typedef sdsl::byte_alphabet												alphabet_type;
+	typedef sdsl::bp_interval <size_type>									node_type;
+	
+	
+	// Index configurations that may be selected at run time.
+	enum class index_configuration : std::uint8_t
+	{
+		SMALL_ALPHABET	= 0,	// Flat rank for alphabets of at most eight symbols, Hu-Tucker otherwise.
+		HUFFMAN			= 1,	// Huffman-shaped wavelet tree with plain bit vectors.
+		COMPACT			= 2		// Huffman-shaped wavelet tree with RRR bit vectors.
+	};
+	
+	
+	// Suffix array sample densities that may be selected at run time.
+	// Finding the superstring does not locate suffixes, so sparse sampling
+	// suffices unless assertions are enabled.
+	enum class index_sampling : std::uint8_t
+	{
+		SPARSE			= 0,	// One sample per 2^20 rows and text positions.
+		DENSE			= 1		// One sample per four rows and text positions.
+	};
+	
+	template <index_sampling t_sampling>
+	struct index_sampling_trait {};
+	
+	template <>
+	struct index_sampling_trait <index_sampling::SPARSE>
+	{
+		enum : std::uint32_t { SA_SAMPLES = 1 << 20, ISA_SAMPLES = 1 << 20 };
+	};
+	
+	template <>
+	struct index_sampling_trait <index_sampling::DENSE>
+	{
+		enum : std::uint32_t { SA_SAMPLES = 4, ISA_SAMPLES = 4 };
+	};
+	
+	
+	// The type tag stored in the index header.
+	struct index_tag
+	{
+		index_configuration	configuration{index_configuration::SMALL_ALPHABET};
+		index_sampling		sampling{index_sampling::SPARSE};
+	};
+	
+	
+	template <index_configuration t_configuration, typename t_wt, index_sampling t_sampling>
+	struct index_policy
+	{
+		typedef index_sampling_trait <t_sampling>								sampling_trait;
+		typedef t_wt															wt_type;
+		typedef sdsl::csa_wt <
+			wt_type,
+			sampling_trait::SA_SAMPLES,
+			sampling_trait::ISA_SAMPLES
+		>																		csa_type;
+		typedef sdsl::lcp_support_tree2 <256>									lcp_support_type;
+		typedef sdsl::cst_sct3 <csa_type, lcp_support_type>						cst_type;
+		
+		static constexpr index_configuration configuration{t_configuration};
+		static constexpr index_sampling sampling{t_sampling};
+		
+		// The rest of the program relies on these being the same in every configuration.
+		static_assert(std::is_same <typename csa_type::size_type, size_type>::value, "Unexpected size_type.");
+		static_assert(std::is_same <typename csa_type::alphabet_type, alphabet_type>::value, "Unexpected alphabet_type.");
+		static_assert(std::is_same <typename cst_type::node_type, node_type>::value, "Unexpected node_type.");
+	};
+	
+	template <index_sampling t_sampling>
+	using small_alphabet_index_policy = index_policy <
+		index_configuration::SMALL_ALPHABET,
+		small_alphabet_wt <sdsl::wt_hutu <>>,
+		t_sampling
+	>;
+	
+	template <index_sampling t_sampling>
+	using huffman_index_policy = index_policy <
+		index_configuration::HUFFMAN,
+		sdsl::wt_huff <>,
+		t_sampling
+	>;
+	
+	template <index_sampling t_sampling>
+	using compact_index_policy = index_policy <
+		index_configuration::COMPACT,
+		sdsl::wt_huff <sdsl::rrr_vector <63>>,
+		t_sampling
+	>;
+	
+	
+	// Call fn with an instance of the policy of the given configuration and sampling.
+	template <index_sampling t_sampling, typename t_fn>
+	void dispatch_index_configuration(index_configuration const configuration, t_fn &&fn)
+	{
+		switch (configuration)
+		{
+			case index_configuration::SMALL_ALPHABET:
+				fn(small_alphabet_index_policy <t_sampling>());
+				break;
+				
+			case index_configuration::HUFFMAN:
+				fn(huffman_index_policy <t_sampling>());
+				break;
+				
+			case index_configuration::COMPACT:
+				fn(compact_index_policy <t_sampling>());
+				break;
+				
+			default:
+			{
+				std::stringstream output;
+				output << "Unexpected index configuration " << +static_cast <std::uint8_t>(configuration) << ".";
+				throw std::runtime_error(output.str());
+			}
+		}
+	}
+	
+	template <typename t_fn>
+	void dispatch_index_configuration(index_tag const &tag, t_fn &&fn)
+	{
+		switch (tag.sampling)
+		{
+			case index_sampling::SPARSE:
+				dispatch_index_configuration <index_sampling::SPARSE>(tag.configuration, fn);
+				break;
+				
+			case index_sampling::DENSE:
+				dispatch_index_configuration <index_sampling::DENSE>(tag.configuration, fn);
+				break;
+				
+			default:
+			{
+				std::stringstream output;
+				output << "Unexpected index sampling " << +static_cast <std::uint8_t>(tag.sampling) << ".";
+				throw std::runtime_error(output.str());
+			}
+		}
+	}
 
+	
 	class string_array;
-
 	
+	
+	// The index is preceded by a header that contains the version and the
+	// type tag. The header is written by serialize() but load() expects it
+	// to have been read with read_index_header().
+	template <typename t_policy>
 	struct index_type
 	{
-		typedef std::size_t size_type;
+		typedef std::size_t							size_type;
+		typedef t_policy							policy_type;
+		typedef typename policy_type::cst_type		cst_type;
 		
 		cst_type cst;
 		sdsl::int_vector <> string_lengths;
+		string_sample_map string_samples;
 		char sentinel{1};
 		bool index_contains_debugging_information{TRIBBLE_ASSERTIONS_ENABLED};
 		
 		index_type() = default;
 		
-		index_type(cst_type &cst_p, sdsl::int_vector <> string_lengths_p, char const sentinel_p):
+		index_type(cst_type &cst_p, sdsl::int_vector <> string_lengths_p, string_sample_map &string_samples_p, char const sentinel_p):
 			cst(std::move(cst_p)),
 			string_lengths(std::move(string_lengths_p)),
+			string_samples(std::move(string_samples_p)),
 			sentinel(sentinel_p)
 		{
 		}
@@ -84,11 +238,16 @@ namespace tribble {
 			
 			{
 				uint32_t const index_version(INDEX_VERSION);
+				std::uint8_t const configuration(static_cast <std::uint8_t>(policy_type::configuration));
+				std::uint8_t const sampling(static_cast <std::uint8_t>(policy_type::sampling));
 				written_bytes += sdsl::write_member(index_version, out, child, "index_version");
+				written_bytes += sdsl::write_member(configuration, out, child, "configuration");
+				written_bytes += sdsl::write_member(sampling, out, child, "sampling");
 			}
 			
 			written_bytes += cst.serialize(out, child, "cst");
 			written_bytes += string_lengths.serialize(out, child, "string_lengths");
+			written_bytes += string_samples.serialize(out, child, "string_samples");
 			written_bytes += sdsl::write_member(sentinel, out, child, "sentinel");
 			written_bytes += sdsl::write_member(
 				index_contains_debugging_information,
@@ -103,25 +262,54 @@ namespace tribble {
 		
 		void load(std::istream &in)
 		{
-			{
-				uint32_t index_version(0);
-				sdsl::read_member(index_version, in);
-				if (INDEX_VERSION != index_version)
-				{
-					std::stringstream output;
-					output << "Given index version was " << index_version << ", expected " << INDEX_VERSION << ".";
-					throw std::runtime_error(output.str());
-				}
-			}
-			
 			cst.load(in);
 			string_lengths.load(in);
+			string_samples.load(in);
 			sdsl::read_member(sentinel, in);
 			sdsl::read_member(index_contains_debugging_information, in);
 		}
 	};
 	
 	
+	inline index_tag read_index_header(std::istream &in)
+	{
+		{
+			uint32_t index_version(0);
+			sdsl::read_member(index_version, in);
+			if (INDEX_VERSION != index_version)
+			{
+				std::stringstream output;
+				output << "Given index version was " << index_version << ", expected " << INDEX_VERSION << ".";
+				throw std::runtime_error(output.str());
+			}
+		}
+		
+		std::uint8_t configuration(0);
+		std::uint8_t sampling(0);
+		sdsl::read_member(configuration, in);
+		sdsl::read_member(sampling, in);
+		
+		index_tag tag;
+		tag.configuration = static_cast <index_configuration>(configuration);
+		tag.sampling = static_cast <index_sampling>(sampling);
+		return tag;
+	}
+	
+	
+	// Load the index and pass it to fn, which should accept any index_type.
+	template <typename t_fn>
+	void load_index(std::istream &in, t_fn &&fn)
+	{
+		auto const tag(read_index_header(in));
+		dispatch_index_configuration(tag, [&in, &fn](auto const &policy){
+			typedef std::decay_t <decltype(policy)> policy_type;
+			index_type <policy_type> index;
+			index.load(in);
+			fn(index);
+		});
+	}
+	
+	
 	struct error_handler
 	{
 		virtual void handle_exception(std::exception const &exc) = 0;
@@ -157,23 +345,45 @@ namespace tribble {
 
 
 	void create_index(
-		std::istream &source_stream,
+		std::vector <std::string> const &source_fnames,
 		std::ostream &index_stream,
 		std::ostream &strings_stream,
 		char const *strings_fname,
 		enum_source_format source_format,
+		bool const input_is_sorted,
+		enum_strings_format strings_format,
+		enum_index_construction index_construction,
+		index_tag const &tag,
 		char const sentinel,
+		std::size_t const memory_budget,
+		std::size_t const thread_count,
+		std::size_t const shard_count,
+		error_handler &error_handler
+	);
+	void update_index(
+		char const *source_fname,
+		std::istream &base_index_stream,
+		char const *base_strings_fname,
+		std::ostream &index_stream,
+		std::ostream &strings_stream,
+		enum_source_format source_format,
+		std::size_t const thread_count,
 		error_handler &error_handler
 	);
+	template <typename t_cst>
 	void check_non_unique_strings(
-		cst_type const &cst,
+		t_cst const &cst,
 		sdsl::int_vector <> const &string_lengths,
+		string_sample_map const &string_samples,
 		char const sentinel,
+		std::size_t const thread_count,
 		/* out */ string_array &strings_available
 	);
 	void find_suffixes(
 		std::istream &index_stream,
 		std::istream &strings_stream,
+		char const *cache_fname,
+		std::size_t const thread_count,
 		find_superstring_match_callback &cb
 	);
 	void visualize(std::istream &index_stream, std::ostream &memory_chart_stream);
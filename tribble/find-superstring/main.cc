@@ -15,7 +15,11 @@
  */
 
 
+#include <algorithm>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
 #include <tribble/io.hh>
 #include "cmdline.h"
 #include "find_superstring.hh"
@@ -73,7 +77,7 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	
 	// Check the remaining options.
-	if (args_info.create_index_given || args_info.find_superstring_given)
+	if (args_info.create_index_given || args_info.update_index_given || args_info.find_superstring_given)
 	{
 		if (!args_info.sorted_strings_file_given)
 		{
@@ -82,6 +86,17 @@ int main(int argc, char **argv)
 		}
 	}
 	
+	std::size_t thread_count(std::max(1U, std::thread::hardware_concurrency()));
+	if (args_info.threads_given)
+	{
+		if (args_info.threads_arg <= 0)
+		{
+			std::cerr << "ERROR: The number of threads should be positive." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		thread_count = args_info.threads_arg;
+	}
+	
 	// See if memory monitor should be used.
 	bool const log_memory_usage(args_info.output_memory_usage_given);
 	tribble::file_ostream mem_usage_stream;
@@ -105,40 +120,186 @@ int main(int argc, char **argv)
 			sentinel_character = args_info.sentinel_character_arg;
 		}
 		
-		tribble::file_istream source_stream;
+		std::size_t memory_budget(0);
+		if (args_info.memory_budget_given)
+		{
+			if (args_info.memory_budget_arg <= 0)
+			{
+				std::cerr << "ERROR: The memory budget should be positive." << std::endl;
+				exit(EXIT_FAILURE);
+			}
+			memory_budget = 1024 * 1024 * std::size_t(args_info.memory_budget_arg);
+		}
+		
+		std::size_t shard_count(1);
+		if (args_info.shards_given)
+		{
+			if (args_info.shards_arg <= 0)
+			{
+				std::cerr << "ERROR: The number of shards should be positive." << std::endl;
+				exit(EXIT_FAILURE);
+			}
+			shard_count = args_info.shards_arg;
+		}
+		
+		tribble::index_tag index_tag;
+		switch (args_info.index_type_arg)
+		{
+			case index_type_arg_default:
+				break;
+				
+			case index_type_arg_huffman:
+				index_tag.configuration = tribble::index_configuration::HUFFMAN;
+				break;
+				
+			case index_type_arg_compact:
+				index_tag.configuration = tribble::index_configuration::COMPACT;
+				break;
+				
+			default:
+				std::cerr << "ERROR: Unexpected index type." << std::endl;
+				exit(EXIT_FAILURE);
+		}
+		
+		switch (args_info.index_sampling_arg)
+		{
+			case index_sampling_arg_default:
+				index_tag.sampling = TRIBBLE_DEFAULT_INDEX_SAMPLING;
+				break;
+				
+			case index_sampling_arg_sparse:
+				index_tag.sampling = tribble::index_sampling::SPARSE;
+				break;
+				
+			case index_sampling_arg_dense:
+				index_tag.sampling = tribble::index_sampling::DENSE;
+				break;
+				
+			default:
+				std::cerr << "ERROR: Unexpected index sampling." << std::endl;
+				exit(EXIT_FAILURE);
+		}
+		
+		// Collect the source file names from the arguments and the list file.
+		std::vector <std::string> source_fnames(args_info.source_file_arg, args_info.source_file_arg + args_info.source_file_given);
+		if (args_info.source_file_list_given)
+		{
+			tribble::file_istream list_stream;
+			tribble::open_file_for_reading(args_info.source_file_list_arg, list_stream);
+			std::string line;
+			while (std::getline(list_stream, line))
+			{
+				if (!line.empty())
+					source_fnames.emplace_back(std::move(line));
+			}
+		}
+		
+		if (source_fnames.empty())
+		{
+			std::cerr << "ERROR: At least one source file needs to be specified." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		
+		// Several files are read in parallel, so their order is not preserved.
+		bool const input_is_sorted(args_info.input_is_sorted_given);
+		if (input_is_sorted && 1 < source_fnames.size())
+		{
+			std::cerr << "ERROR: Sorted input may only be read from one source file." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		
+		// The source files are opened when reading, since they may be mapped.
 		tribble::file_ostream index_stream;
 		tribble::file_ostream strings_stream;
 		
-		tribble::open_file_for_reading(args_info.source_file_arg, source_stream);
 		tribble::open_file_for_writing(args_info.index_file_arg, index_stream);
 		tribble::open_file_for_writing(args_info.sorted_strings_file_arg, strings_stream);
 		
 		error_handler eh;
 		tribble::create_index(
-			source_stream,
+			source_fnames,
 			index_stream,
 			strings_stream,
 			args_info.sorted_strings_file_arg,
 			args_info.source_format_arg,
+			input_is_sorted,
+			args_info.strings_format_arg,
+			args_info.index_construction_arg,
+			index_tag,
 			sentinel_character,
+			memory_budget,
+			thread_count,
+			shard_count,
+			eh
+		);
+	}
+	else if (args_info.update_index_given)
+	{
+		enum_source_format source_format(source_format_arg_FASTA);
+		switch (args_info.added_strings_format_arg)
+		{
+			case added_strings_format_arg_FASTA:
+				break;
+				
+			case added_strings_format_arg_FASTQ:
+				source_format = source_format_arg_FASTQ;
+				break;
+				
+			case added_strings_format_arg_text:
+				source_format = source_format_arg_text;
+				break;
+				
+			default:
+				std::cerr << "ERROR: Unexpected source format." << std::endl;
+				exit(EXIT_FAILURE);
+		}
+		
+		// The source file is opened when reading, since it may be mapped.
+		tribble::mapped_file_istream base_index_stream;
+		tribble::file_ostream index_stream;
+		tribble::file_ostream strings_stream;
+		
+		tribble::open_file_for_reading(args_info.base_index_file_arg, base_index_stream);
+		tribble::open_file_for_writing(args_info.index_file_arg, index_stream);
+		tribble::open_file_for_writing(args_info.sorted_strings_file_arg, strings_stream);
+		
+		error_handler eh;
+		tribble::update_index(
+			args_info.added_strings_file_arg,
+			base_index_stream,
+			args_info.base_strings_file_arg,
+			index_stream,
+			strings_stream,
+			source_format,
+			thread_count,
 			eh
 		);
 	}
 	else if (args_info.find_superstring_given)
 	{
-		tribble::file_istream index_stream;
-		tribble::file_istream strings_stream;
+		// Map the index and the strings so that their largest parts need not be copied.
+		tribble::mapped_file_istream index_stream;
+		tribble::mapped_file_istream strings_stream;
 		
 		tribble::open_file_for_reading(args_info.index_file_arg, index_stream);
 		tribble::open_file_for_reading(args_info.sorted_strings_file_arg, strings_stream);
 		
+		// Cache the checked and sorted strings next to the index unless disabled.
+		std::string const cache_fname(std::string(args_info.index_file_arg) + ".cache");
+		
 		tribble::Superstring_callback cb;
 		//tribble::find_superstring_match_dummy_callback cb;
-		tribble::find_suffixes(index_stream, strings_stream, cb);
+		tribble::find_suffixes(
+			index_stream,
+			strings_stream,
+			(args_info.no_string_cache_given ? nullptr : cache_fname.c_str()),
+			thread_count,
+			cb
+		);
 	}
 	else if (args_info.index_visualization_given)
 	{
-		tribble::file_istream index_stream;
+		tribble::mapped_file_istream index_stream;
 		tribble::file_ostream memory_chart_stream;
 
 		tribble::open_file_for_reading(args_info.index_file_arg, index_stream);
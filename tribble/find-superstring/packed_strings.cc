@@ -0,0 +1,155 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#include <algorithm>
+#include <sdsl/io.hpp>
+#include <stdexcept>
+#include "packed_strings.hh"
+
+
+namespace tribble {
+	
+	void packed_strings::build(char const *data, size_type const size, char const sentinel)
+	{
+		auto const *begin(reinterpret_cast <std::uint8_t const *>(data));
+		auto const *end(begin + size);
+		
+		if (size && sentinel != data[0])
+			throw std::runtime_error("The strings file does not begin with the sentinel.");
+		if (size && sentinel != data[size - 1])
+			throw std::runtime_error("The strings file does not end with the sentinel.");
+		
+		// Determine the alphabet and the string count.
+		std::array <std::uint8_t, 256> char2comp{};
+		{
+			std::array <bool, 256> seen{};
+			for (auto const *it(begin); it != end; ++it)
+				seen[*it] = true;
+			
+			m_string_count = (size ? std::count(begin, end, std::uint8_t(sentinel)) - 1 : 0);
+			m_size = size - (size ? 1 + m_string_count : 0);
+			
+			seen[std::uint8_t(sentinel)] = false;
+			std::size_t sigma(0);
+			for (std::size_t i(0); i < 256; ++i)
+			{
+				if (seen[i])
+				{
+					char2comp[i] = sigma;
+					m_comp2char[sigma] = i;
+					++sigma;
+				}
+			}
+			m_width = (sigma <= 1 ? 1 : 1 + sdsl::bits::hi(sigma - 1));
+		}
+		
+		// Pack the characters and mark the string boundaries.
+		mappable_vector <std::uint64_t> words((m_size * m_width + 63) / 64, 0);
+		sdsl::bit_vector string_starts(1 + m_size + m_string_count, 0);
+		{
+			std::uint64_t pos(0);
+			std::uint64_t idx(0);
+			if (size)
+			{
+				for (auto const *it(begin + 1); it != end; ++it)
+				{
+					auto const c(*it);
+					if (sentinel == char(c))
+					{
+						++idx;
+						string_starts[pos + idx] = 1;
+						continue;
+					}
+					
+					auto const bit_pos(pos * m_width);
+					sdsl::bits::write_int(words.data() + (bit_pos >> 6), char2comp[c], bit_pos & 0x3f, m_width);
+					++pos;
+				}
+			}
+			
+			// The first string starts at the beginning. If there are no strings,
+			// this is also the end.
+			string_starts[0] = 1;
+		}
+		
+		m_words = std::move(words);
+		m_string_starts = sdsl::sd_vector <>(string_starts);
+		m_string_starts_select.set_vector(&m_string_starts);
+	}
+	
+	
+	auto packed_strings::serialize(
+		std::ostream &out,
+		sdsl::structure_tree_node *v,
+		std::string name
+	) const -> size_type
+	{
+		sdsl::structure_tree_node *child(sdsl::structure_tree::add_child(v, name, "tribble::packed_strings"));
+		size_type written_bytes(0);
+		
+		{
+			std::uint32_t const magic(MAGIC);
+			std::uint32_t const format_version(FORMAT_VERSION);
+			written_bytes += sdsl::write_member(magic, out, child, "magic");
+			written_bytes += sdsl::write_member(format_version, out, child, "format_version");
+		}
+		
+		written_bytes += sdsl::write_member(m_size, out, child, "size");
+		written_bytes += sdsl::write_member(m_string_count, out, child, "string_count");
+		written_bytes += sdsl::write_member(m_width, out, child, "width");
+		out.write(reinterpret_cast <char const *>(m_comp2char.data()), m_comp2char.size());
+		written_bytes += m_comp2char.size();
+		written_bytes += m_string_starts.serialize(out, child, "string_starts");
+		written_bytes += m_words.serialize(out, child, "words");
+		
+		sdsl::structure_tree::add_size(child, written_bytes);
+		return written_bytes;
+	}
+	
+	
+	void packed_strings::load(std::istream &in)
+	{
+		{
+			std::uint32_t magic(0);
+			std::uint32_t format_version(0);
+			sdsl::read_member(magic, in);
+			sdsl::read_member(format_version, in);
+			if (MAGIC != magic)
+				throw std::runtime_error("The strings file is not in the packed format.");
+			if (FORMAT_VERSION != format_version)
+				throw std::runtime_error("Unexpected packed strings format version.");
+		}
+		
+		sdsl::read_member(m_size, in);
+		sdsl::read_member(m_string_count, in);
+		sdsl::read_member(m_width, in);
+		in.read(reinterpret_cast <char *>(m_comp2char.data()), m_comp2char.size());
+		m_string_starts.load(in);
+		m_string_starts_select.set_vector(&m_string_starts);
+		m_words.load(in);
+		
+		if (!in)
+			throw std::runtime_error("Unable to read the packed strings.");
+	}
+	
+	
+	bool packed_strings::is_packed(std::istream &in)
+	{
+		// A plain strings file begins with the sentinel, which is in the range 1…127.
+		auto const c(in.peek());
+		return std::istream::traits_type::eof() != c && (MAGIC & 0xff) == std::uint32_t(c);
+	}
+}
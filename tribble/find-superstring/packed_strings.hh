@@ -0,0 +1,88 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_PACKED_STRINGS_HH
+#define TRIBBLE_PACKED_STRINGS_HH
+
+#include <array>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <sdsl/bits.hpp>
+#include <sdsl/sd_vector.hpp>
+#include <string>
+#include <tribble/mappable_vector.hh>
+
+
+namespace tribble {
+	
+	// The sorted strings stored at the width of their alphabet without the
+	// separators. The string boundaries are stored in an Elias-Fano coded
+	// bit vector, so any string may be accessed in constant time. The
+	// characters may be used from a mapped file without copying.
+	class packed_strings
+	{
+	public:
+		typedef std::size_t size_type;
+		
+		enum : std::uint32_t { MAGIC = 0x53505489 }; // Begins with a byte that is not a valid sentinel.
+		enum : std::uint32_t { FORMAT_VERSION = 1 };
+		
+	protected:
+		mappable_vector <std::uint64_t>		m_words;
+		sdsl::sd_vector <>					m_string_starts;
+		sdsl::sd_vector <>::select_1_type	m_string_starts_select;
+		std::array <std::uint8_t, 256>		m_comp2char{};
+		std::uint64_t						m_size{0};
+		std::uint64_t						m_string_count{0};
+		std::uint8_t						m_width{1};
+		
+	protected:
+		// The boundaries are stored as the starting position of each string plus
+		// its index followed by the size of the characters plus the string count,
+		// which makes the positions unique also if there are empty strings.
+		inline size_type string_begin_(size_type const idx) const { return m_string_starts_select(1 + idx) - idx; }
+		
+	public:
+		packed_strings() = default;
+		packed_strings(packed_strings const &) = delete;
+		packed_strings &operator=(packed_strings const &) = delete;
+		
+		// Pack the contents of a strings file, i.e. the strings preceded and
+		// followed by the sentinel.
+		void build(char const *data, size_type const size, char const sentinel);
+		
+		size_type serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name = "") const;
+		void load(std::istream &in);
+		
+		// Check whether the stream begins with a packed strings header
+		// without consuming any characters.
+		static bool is_packed(std::istream &in);
+		
+		inline size_type string_count() const { return m_string_count; }
+		inline size_type string_begin(size_type const idx) const { return string_begin_(idx); }
+		inline size_type string_length(size_type const idx) const { return string_begin_(1 + idx) - string_begin_(idx); }
+		
+		inline char character(size_type const pos) const
+		{
+			auto const bit_pos(pos * m_width);
+			auto const comp(sdsl::bits::read_int(m_words.data() + (bit_pos >> 6), bit_pos & 0x3f, m_width));
+			return m_comp2char[comp];
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,274 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_READ_SEQUENCES_HH
+#define TRIBBLE_READ_SEQUENCES_HH
+
+#include <algorithm>
+#include <dispatch/dispatch.h>
+#include <exception>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tribble/decompressing_istream.hh>
+#include <tribble/dispatch_fn.hh>
+#include <tribble/fasta_reader.hh>
+#include <tribble/fastq_reader.hh>
+#include <tribble/io.hh>
+#include <tribble/line_reader.hh>
+#include <tribble/mapped_file.hh>
+#include <tribble/parallel_fasta_reader.hh>
+#include <tribble/vector_source.hh>
+#include <vector>
+#include "cmdline.h" // For enum_source_format
+#include "sequence_store.hh"
+#include "strings_file_reader.hh"
+
+
+namespace tribble {
+	
+	// Pass the strings of a strings file written by an earlier run to the
+	// callback as pointers to the mapping, numbered like lines.
+	template <typename t_callback>
+	void read_strings_file(mapped_file const &source_file, t_callback &cb)
+	{
+		strings_file_reader reader(source_file);
+		std::uint8_t const *data(nullptr);
+		std::size_t length(0);
+		uint32_t string_no(0);
+		while (reader.read_next(data, length))
+		{
+			++string_no;
+			if (length)
+				cb.handle_sequence(string_no, data, length);
+		}
+		
+		cb.finish();
+	}
+	
+	
+	// Read the sequences from the given file and pass them to the callback.
+	// Uncompressed regular files are mapped and the sequences are passed as
+	// pointers to the mapping where possible; FASTA is also parsed in
+	// parallel. Other files, e.g. compressed files and pipes, are read with
+	// the stream readers while decompressing in a separate thread.
+	template <typename t_callback>
+	void read_sequences(
+		char const *source_fname,
+		enum_source_format const source_format,
+		std::size_t const thread_count,
+		t_callback &cb
+	)
+	{
+		if (! (
+			source_format_arg_FASTA == source_format ||
+			source_format_arg_FASTQ == source_format ||
+			source_format_arg_text == source_format ||
+			source_format_arg_strings == source_format
+		))
+		{
+			std::stringstream output;
+			output << "Unexpected source file format '" << source_format << "'.";
+			
+			throw std::runtime_error(output.str());
+		}
+		
+		mapped_file source_file;
+		if (is_regular_file(source_fname))
+		{
+			open_file_for_reading(source_fname, source_file);
+			if (compression_type::NONE != detect_compression(source_file.data(), source_file.size()))
+				source_file.close();
+		}
+		
+		if (source_format_arg_strings == source_format)
+		{
+			if (!source_file.is_open())
+				throw std::runtime_error("A strings file needs to be an uncompressed regular file.");
+			
+			source_file.advise_sequential();
+			read_strings_file(source_file, cb);
+		}
+		else if (source_file.is_open())
+		{
+			source_file.advise_sequential();
+			
+			if (source_format_arg_FASTA == source_format)
+			{
+				parallel_fasta_reader <t_callback> reader(thread_count);
+				reader.read_from_buffer(source_file.data(), source_file.size(), cb);
+			}
+			else if (source_format_arg_FASTQ == source_format)
+			{
+				fastq_reader <t_callback> reader;
+				reader.read_from_buffer(source_file.data(), source_file.size(), cb);
+			}
+			else
+			{
+				line_reader <t_callback> reader;
+				reader.read_from_buffer(source_file.data(), source_file.size(), cb);
+			}
+		}
+		else
+		{
+			decompressing_istream source_stream;
+			open_file_for_reading(source_fname, source_stream);
+			vector_source vs(1, false);
+			
+			if (source_format_arg_FASTA == source_format)
+			{
+				fasta_reader <t_callback> reader;
+				reader.read_from_stream(source_stream, vs, cb);
+			}
+			else if (source_format_arg_FASTQ == source_format)
+			{
+				fastq_reader <t_callback> reader;
+				reader.read_from_stream(source_stream, vs, cb);
+			}
+			else
+			{
+				line_reader <t_callback> reader;
+				reader.read_from_stream(source_stream, vs, cb);
+			}
+		}
+	}
+	
+	
+	// Collect the sequences of one file and pass them to a shared callback
+	// in batches, so that several files may be read in parallel.
+	template <typename t_callback>
+	class batching_callback
+	{
+	public:
+		typedef vector_source::vector_type vector_type;
+		
+	protected:
+		t_callback			*m_cb{nullptr};
+		std::mutex			*m_mutex{nullptr};
+		sequence_store		m_batch;
+		std::size_t			m_batch_size{0};
+		
+	protected:
+		void add(std::uint8_t const *data, std::size_t const seq_length)
+		{
+			m_batch.push_back(data, seq_length);
+			if (m_batch_size <= m_batch.total_length())
+				flush();
+		}
+		
+		void flush()
+		{
+			std::string const identifier;
+			std::lock_guard <std::mutex> lock(*m_mutex);
+			for (std::size_t i(0), count(m_batch.size()); i < count; ++i)
+			{
+				auto const seq(m_batch[i]);
+				m_cb->handle_sequence(identifier, seq.first, seq.second);
+			}
+			m_batch.clear();
+		}
+		
+	public:
+		batching_callback(t_callback &cb, std::mutex &mutex, std::size_t const batch_size = 16 * 1024 * 1024):
+			m_cb(&cb),
+			m_mutex(&mutex),
+			m_batch_size(batch_size)
+		{
+		}
+		
+		void handle_sequence(
+			std::string const &identifier,
+			std::unique_ptr <vector_type> &seq,
+			std::size_t const seq_length,
+			vector_source &vs
+		)
+		{
+			// This is safe because the element width is 8.
+			add(reinterpret_cast <std::uint8_t const *>(seq->data()), seq_length);
+			vs.put_vector(seq);
+		}
+		
+		void handle_sequence(
+			uint32_t const lineno,
+			std::unique_ptr <vector_type> &seq,
+			std::size_t const seq_length,
+			vector_source &vs
+		)
+		{
+			add(reinterpret_cast <std::uint8_t const *>(seq->data()), seq_length);
+			vs.put_vector(seq);
+		}
+		
+		void handle_sequence(std::string const &identifier, std::uint8_t const *data, std::size_t const seq_length) { add(data, seq_length); }
+		void handle_sequence(uint32_t const lineno, std::uint8_t const *data, std::size_t const seq_length) { add(data, seq_length); }
+		
+		// Called by the reader when the file has been read.
+		void finish() { flush(); }
+	};
+	
+	
+	// Read the sequences from the given files and pass them to the callback,
+	// which needs to handle sequences given as pointers. Several files are
+	// read in parallel, so the order in which the sequences are passed is
+	// not specified. The callback's finish() is called once at the end.
+	template <typename t_callback>
+	void read_sequences(
+		std::vector <std::string> const &source_fnames,
+		enum_source_format const source_format,
+		std::size_t const thread_count,
+		t_callback &cb
+	)
+	{
+		auto const file_count(source_fnames.size());
+		if (1 == file_count)
+		{
+			read_sequences(source_fnames.front().c_str(), source_format, thread_count, cb);
+			return;
+		}
+		
+		// Divide the threads among the files.
+		std::size_t const worker_count(std::max(std::size_t(1), std::min(file_count, thread_count)));
+		std::size_t const threads_per_file(std::max(std::size_t(1), thread_count / worker_count));
+		std::mutex mutex;
+		std::exception_ptr exc;
+		dispatch_queue_t queue(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+		dispatch_apply_fn(worker_count, queue, [&](std::size_t const worker_idx) {
+			try
+			{
+				for (std::size_t i(worker_idx); i < file_count; i += worker_count)
+				{
+					batching_callback <t_callback> batching_cb(cb, mutex);
+					read_sequences(source_fnames[i].c_str(), source_format, threads_per_file, batching_cb);
+				}
+			}
+			catch (...)
+			{
+				// Rethrow the first exception on the calling thread.
+				std::lock_guard <std::mutex> lock(mutex);
+				if (!exc)
+					exc = std::current_exception();
+			}
+		});
+		
+		if (exc)
+			std::rethrow_exception(exc);
+		
+		cb.finish();
+	}
+}
+
+#endif
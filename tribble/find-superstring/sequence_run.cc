@@ -0,0 +1,274 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include "sequence_run.hh"
+#include "sequence_store.hh"
+
+
+namespace {
+	
+	void handle_run_error(char const *reason)
+	{
+		std::string message("Unable to ");
+		message += reason;
+		message += " a temporary file: ";
+		message += std::strerror(errno);
+		throw std::runtime_error(message);
+	}
+	
+	
+	// Merge the given runs and pass each unique sequence to fn.
+	template <typename t_fn>
+	void merge_unique_sequences(
+		tribble::sequence_run *runs,
+		std::size_t const run_count,
+		std::size_t const buffer_size,
+		t_fn &&fn
+	)
+	{
+		// Keep the indices of the runs in a min-heap ordered by the current sequence.
+		// Break ties by the run index so that the order is deterministic.
+		auto const cmp([runs](std::size_t const lhs, std::size_t const rhs) -> bool {
+			auto const &lhs_run(runs[lhs]);
+			auto const &rhs_run(runs[rhs]);
+			if (tribble::sequence_less(rhs_run.current_data(), rhs_run.current_length(), lhs_run.current_data(), lhs_run.current_length()))
+				return true;
+			if (tribble::sequence_less(lhs_run.current_data(), lhs_run.current_length(), rhs_run.current_data(), rhs_run.current_length()))
+				return false;
+			return rhs < lhs;
+		});
+		std::priority_queue <std::size_t, std::vector <std::size_t>, decltype(cmp)> queue(cmp);
+		
+		for (std::size_t i(0); i < run_count; ++i)
+		{
+			auto &run(runs[i]);
+			run.start_reading(buffer_size);
+			if (run.read_next())
+				queue.push(i);
+			else
+				run.close();
+		}
+		
+		// The current sequences in the runs get overwritten, so the previous
+		// sequence needs to be copied for detecting duplicates.
+		std::vector <std::uint8_t> previous;
+		bool has_previous(false);
+		while (!queue.empty())
+		{
+			auto const idx(queue.top());
+			queue.pop();
+			
+			auto &run(runs[idx]);
+			auto const *data(run.current_data());
+			auto const length(run.current_length());
+			if (! (has_previous && length == previous.size() && std::equal(data, data + length, previous.begin())))
+			{
+				fn(data, length);
+				previous.assign(data, data + length);
+				has_previous = true;
+			}
+			
+			if (run.read_next())
+				queue.push(idx);
+			else
+				run.close();
+		}
+	}
+}
+
+
+namespace tribble {
+	
+	sequence_run &sequence_run::operator=(sequence_run &&other)
+	{
+		remove();
+		m_path = std::move(other.m_path);
+		m_fp = other.m_fp;
+		m_buffer = std::move(other.m_buffer);
+		m_current = std::move(other.m_current);
+		m_current_length = other.m_current_length;
+		m_string_count = other.m_string_count;
+		m_max_length = other.m_max_length;
+		other.m_path.clear();
+		other.m_fp = nullptr;
+		return *this;
+	}
+	
+	
+	void sequence_run::open(char const *neighbour_fname)
+	{
+		assert(!m_fp);
+		assert(m_path.empty());
+		
+		// Place the file next to the given one since /tmp may reside in memory.
+		std::string path_template(neighbour_fname);
+		path_template += ".run.XXXXXX";
+		
+		int const fd(mkstemp(&path_template[0]));
+		if (-1 == fd)
+			handle_run_error("create");
+		
+		m_path = std::move(path_template);
+		m_fp = fdopen(fd, "wb");
+		if (!m_fp)
+		{
+			::close(fd);
+			handle_run_error("open");
+		}
+	}
+	
+	
+	void sequence_run::close()
+	{
+		if (m_fp)
+		{
+			std::fclose(m_fp);
+			m_fp = nullptr;
+		}
+		
+		// The buffer may be freed only after closing.
+		m_buffer.clear();
+		m_buffer.shrink_to_fit();
+	}
+	
+	
+	void sequence_run::remove()
+	{
+		close();
+		if (!m_path.empty())
+		{
+			unlink(m_path.c_str());
+			m_path.clear();
+		}
+	}
+	
+	
+	void sequence_run::write(std::uint8_t const *data, std::size_t const length)
+	{
+		assert(m_fp);
+		std::uint64_t const length_(length);
+		if (1 != std::fwrite(&length_, sizeof(length_), 1, m_fp))
+			handle_run_error("write to");
+		if (length && 1 != std::fwrite(data, length, 1, m_fp))
+			handle_run_error("write to");
+		
+		++m_string_count;
+		m_max_length = std::max(m_max_length, length);
+	}
+	
+	
+	void sequence_run::finish_writing()
+	{
+		assert(m_fp);
+		int const status(std::fclose(m_fp));
+		m_fp = nullptr;
+		if (0 != status)
+			handle_run_error("write to");
+	}
+	
+	
+	void sequence_run::start_reading(std::size_t const buffer_size)
+	{
+		assert(!m_fp);
+		assert(!m_path.empty());
+		
+		m_fp = std::fopen(m_path.c_str(), "rb");
+		if (!m_fp)
+			handle_run_error("re-open");
+		
+		// setvbuf may only be called before any other operation on the stream.
+		m_buffer.resize(buffer_size);
+		std::setvbuf(m_fp, m_buffer.data(), _IOFBF, buffer_size);
+	}
+	
+	
+	bool sequence_run::read_next()
+	{
+		assert(m_fp);
+		std::uint64_t length(0);
+		if (1 != std::fread(&length, sizeof(length), 1, m_fp))
+		{
+			if (std::ferror(m_fp))
+				handle_run_error("read from");
+			return false;
+		}
+		
+		if (m_current.size() < length)
+			m_current.resize(length);
+		
+		if (length && 1 != std::fread(m_current.data(), length, 1, m_fp))
+			handle_run_error("read from");
+		
+		m_current_length = length;
+		return true;
+	}
+	
+	
+	void merge_sequence_runs(
+		std::vector <sequence_run> &runs,
+		std::size_t const max_fan_in,
+		std::size_t const buffer_size,
+		char const *neighbour_fname,
+		strings_writer &writer
+	)
+	{
+		assert(1 < max_fan_in);
+		
+		// Merge groups of runs until the remaining ones may be read at once.
+		// The runs are removed as soon as they have been merged.
+		while (max_fan_in < runs.size())
+		{
+			std::vector <sequence_run> merged_runs;
+			merged_runs.reserve((runs.size() + max_fan_in - 1) / max_fan_in);
+			
+			for (std::size_t begin(0), count(runs.size()); begin < count; begin += max_fan_in)
+			{
+				auto const end(std::min(count, begin + max_fan_in));
+				if (1 == end - begin)
+				{
+					merged_runs.emplace_back(std::move(runs[begin]));
+					continue;
+				}
+				
+				sequence_run merged_run;
+				merged_run.open(neighbour_fname);
+				merge_unique_sequences(runs.data() + begin, end - begin, buffer_size, [&merged_run](std::uint8_t const *data, std::size_t const length){
+					merged_run.write(data, length);
+				});
+				merged_run.finish_writing();
+				merged_runs.emplace_back(std::move(merged_run));
+				
+				for (std::size_t i(begin); i < end; ++i)
+					runs[i].remove();
+			}
+			
+			runs.swap(merged_runs);
+		}
+		
+		merge_unique_sequences(runs.data(), runs.size(), buffer_size, [&writer](std::uint8_t const *data, std::size_t const length){
+			writer.add(data, length);
+		});
+	}
+}
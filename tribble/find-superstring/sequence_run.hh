@@ -0,0 +1,88 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_SEQUENCE_RUN_HH
+#define TRIBBLE_SEQUENCE_RUN_HH
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "strings_writer.hh"
+
+
+namespace tribble {
+	
+	// A sorted run of sequences spilled to a temporary file.
+	// Each sequence is stored with a length prefix. The file is kept open
+	// only while writing or reading, so that the number of runs is not
+	// limited by the number of open files, and removed when the run is
+	// destroyed.
+	class sequence_run
+	{
+	protected:
+		std::string					m_path;
+		std::FILE					*m_fp{nullptr};
+		std::vector <char>			m_buffer;
+		std::vector <std::uint8_t>	m_current;
+		std::size_t					m_current_length{0};
+		std::size_t					m_string_count{0};
+		std::size_t					m_max_length{0};
+		
+	public:
+		sequence_run() = default;
+		sequence_run(sequence_run const &) = delete;
+		sequence_run(sequence_run &&other) { *this = std::move(other); }
+		~sequence_run() { remove(); }
+		
+		sequence_run &operator=(sequence_run const &) = delete;
+		sequence_run &operator=(sequence_run &&other);
+		
+		// Create the temporary file in the directory of the given file.
+		void open(char const *neighbour_fname);
+		void close();
+		void remove();
+		
+		void write(std::uint8_t const *data, std::size_t const length);
+		void finish_writing();
+		
+		// Open for reading with a buffer of the given size.
+		void start_reading(std::size_t const buffer_size);
+		bool read_next();
+		
+		inline std::uint8_t const *current_data() const { return m_current.data(); }
+		inline std::size_t current_length() const { return m_current_length; }
+		
+		inline std::size_t string_count() const { return m_string_count; }
+		inline std::size_t max_length() const { return m_max_length; }
+	};
+	
+	
+	// Merge the given runs and pass each unique sequence to the writer.
+	// At most max_fan_in runs are read at a time; if there are more,
+	// they are first merged in groups into intermediate runs that are
+	// created next to the given file. Each run being read is given a
+	// buffer of buffer_size bytes.
+	void merge_sequence_runs(
+		std::vector <sequence_run> &runs,
+		std::size_t const max_fan_in,
+		std::size_t const buffer_size,
+		char const *neighbour_fname,
+		strings_writer &writer
+	);
+}
+
+#endif
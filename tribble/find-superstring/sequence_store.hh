@@ -0,0 +1,135 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_SEQUENCE_STORE_HH
+#define TRIBBLE_SEQUENCE_STORE_HH
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+
+namespace tribble {
+	
+	// Compare the sequences lexicographically; a proper prefix precedes the
+	// longer sequence, which matches the order of the strings in the text.
+	inline bool sequence_less(
+		std::uint8_t const *lhs,
+		std::size_t const lhs_length,
+		std::uint8_t const *rhs,
+		std::size_t const rhs_length
+	)
+	{
+		auto const res(std::memcmp(lhs, rhs, std::min(lhs_length, rhs_length)));
+		if (res)
+			return res < 0;
+		return lhs_length < rhs_length;
+	}
+	
+	
+	// Store sequences back to back in one growable buffer. The sequences are
+	// identified by their indices and located with an array of end offsets.
+	class sequence_store
+	{
+	public:
+		typedef std::pair <std::uint8_t const *, std::size_t> sequence_type;
+		
+	protected:
+		std::vector <std::uint8_t>	m_data;
+		std::vector <std::uint64_t>	m_offsets{0};
+		
+	protected:
+		template <typename t_vector>
+		static inline std::size_t next_capacity(t_vector const &vec, std::size_t const additional)
+		{
+			auto const capacity(vec.capacity());
+			auto const required(vec.size() + additional);
+			if (required <= capacity)
+				return capacity;
+			return std::max(2 * capacity, required);
+		}
+		
+		template <typename t_vector>
+		static inline void reserve(t_vector &vec, std::size_t const additional)
+		{
+			// Grow geometrically regardless of the standard library implementation.
+			auto const capacity(next_capacity(vec, additional));
+			if (vec.capacity() < capacity)
+				vec.reserve(capacity);
+		}
+		
+	public:
+		inline std::size_t size() const { return m_offsets.size() - 1; }
+		inline bool empty() const { return 0 == size(); }
+		inline std::size_t total_length() const { return m_data.size(); }
+		
+		// Memory used by the buffers.
+		inline std::size_t memory_usage() const
+		{
+			return m_data.capacity() + sizeof(std::uint64_t) * m_offsets.capacity();
+		}
+		
+		// Memory used by the buffers after adding a sequence of the given length.
+		inline std::size_t memory_usage_after_adding(std::size_t const length) const
+		{
+			return next_capacity(m_data, length) + sizeof(std::uint64_t) * next_capacity(m_offsets, 1);
+		}
+		
+		inline sequence_type operator[](std::size_t const idx) const
+		{
+			assert(idx < size());
+			auto const begin(m_offsets[idx]);
+			auto const end(m_offsets[1 + idx]);
+			return sequence_type(m_data.data() + begin, end - begin);
+		}
+		
+		inline bool is_equal(std::size_t const lhs, std::size_t const rhs) const
+		{
+			auto const lhs_seq((*this)[lhs]);
+			auto const rhs_seq((*this)[rhs]);
+			return (lhs_seq.second == rhs_seq.second && 0 == std::memcmp(lhs_seq.first, rhs_seq.first, lhs_seq.second));
+		}
+		
+		void push_back(std::uint8_t const *data, std::size_t const length)
+		{
+			reserve(m_data, length);
+			reserve(m_offsets, 1);
+			m_data.insert(m_data.end(), data, data + length);
+			m_offsets.push_back(m_data.size());
+		}
+		
+		// Remove the sequences but keep the buffers.
+		void clear()
+		{
+			m_data.clear();
+			m_offsets.resize(1);
+		}
+		
+		// Remove the sequences and free the buffers.
+		void free()
+		{
+			decltype(m_data) empty_data;
+			decltype(m_offsets) empty_offsets(1, 0);
+			m_data.swap(empty_data);
+			m_offsets.swap(empty_offsets);
+		}
+	};
+}
+
+#endif
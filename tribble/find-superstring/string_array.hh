@@ -31,7 +31,7 @@ namespace tribble {
 		typedef sdsl::int_vector <0>::size_type size_type;
 		
 		size_type			sa_idx;
-		cst_type::node_type	matching_node{};
+		node_type	matching_node{};
 		size_type			length;
 		size_type			matching_suffix_length;
 		bool				is_unique;
@@ -55,7 +55,7 @@ namespace tribble {
 			return matching_suffix_length < string.matching_suffix_length;
 		}
 		
-		inline void get_matching_node(cst_type::node_type &target) const
+		inline void get_matching_node(node_type &target) const
 		{
 			target = matching_node;
 		}
@@ -276,7 +276,7 @@ namespace tribble {
 		
 		inline void get(size_type const k, string_type &string) const
 		{
-			cst_type::node_type node(
+			node_type node(
 				m_match_i[k],
 				m_match_j[k],
 				m_match_ipos[k],
@@ -304,6 +304,38 @@ namespace tribble {
 			m_is_unique[k]					= string.is_unique;
 		}
 		
+		size_type serialize(std::ostream &out, sdsl::structure_tree_node *v, std::string name) const
+		{
+			sdsl::structure_tree_node *child(sdsl::structure_tree::add_child(v, name, "tribble::string_array"));
+			size_type written_bytes(0);
+			
+			written_bytes += m_sa_idxs.serialize(out, child, "sa_idxs");
+			written_bytes += m_match_i.serialize(out, child, "match_i");
+			written_bytes += m_match_j.serialize(out, child, "match_j");
+			written_bytes += m_match_ipos.serialize(out, child, "match_ipos");
+			written_bytes += m_match_cipos.serialize(out, child, "match_cipos");
+			written_bytes += m_match_jp1pos.serialize(out, child, "match_jp1pos");
+			written_bytes += m_lengths.serialize(out, child, "lengths");
+			written_bytes += m_matching_suffix_lengths.serialize(out, child, "matching_suffix_lengths");
+			written_bytes += m_is_unique.serialize(out, child, "is_unique");
+			
+			sdsl::structure_tree::add_size(child, written_bytes);
+			return written_bytes;
+		}
+		
+		void load(std::istream &in)
+		{
+			m_sa_idxs.load(in);
+			m_match_i.load(in);
+			m_match_j.load(in);
+			m_match_ipos.load(in);
+			m_match_cipos.load(in);
+			m_match_jp1pos.load(in);
+			m_lengths.load(in);
+			m_matching_suffix_lengths.load(in);
+			m_is_unique.load(in);
+		}
+		
 		inline iterator begin()					{ return iterator(*this, 0); }
 		inline const_iterator begin() const		{ return const_iterator(*this, 0); }
 		inline const_iterator cbegin() const	{ return const_iterator(*this, 0); }
@@ -0,0 +1,154 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sdsl/io.hpp>
+#include <stdexcept>
+#include <string>
+#include <tribble/io.hh>
+#include <unistd.h>
+#include <vector>
+#include "string_cache.hh"
+
+namespace ios = boost::iostreams;
+
+
+namespace {
+	
+	// FNV-1a applied to 64-bit words. The high half of the state is folded
+	// into the low half after each step, since the multiplication only
+	// propagates the bits of the word upwards.
+	std::uint64_t hash_bytes(char const *data, std::size_t const size)
+	{
+		std::uint64_t const prime(0x100000001b3ULL);
+		std::uint64_t hash(0xcbf29ce484222325ULL);
+		
+		std::size_t i(0);
+		for (; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t))
+		{
+			std::uint64_t word(0);
+			std::memcpy(&word, data + i, sizeof(std::uint64_t));
+			hash ^= word;
+			hash *= prime;
+			hash ^= hash >> 32;
+		}
+		
+		for (; i < size; ++i)
+		{
+			hash ^= static_cast <std::uint8_t>(data[i]);
+			hash *= prime;
+		}
+		
+		return hash;
+	}
+}
+
+
+namespace tribble {
+	
+	bool hash_index(std::istream &index_stream, std::uint64_t &index_size, std::uint64_t &index_hash)
+	{
+		auto const *buffer(dynamic_cast <memory_streambuf const *>(index_stream.rdbuf()));
+		if (!buffer)
+			return false;
+		
+		index_size = buffer->available();
+		index_hash = hash_bytes(buffer->current(), index_size);
+		return true;
+	}
+	
+	
+	bool load_string_cache(
+		char const *fname,
+		std::uint64_t const index_size,
+		std::uint64_t const index_hash,
+		string_array &strings,
+		sdsl::bit_vector &is_unique_sa_order
+	)
+	{
+		int const fd(open(fname, O_RDONLY));
+		if (-1 == fd)
+			return false;
+		
+		mapped_file_istream stream;
+		stream.open(fd);
+		
+		{
+			std::uint32_t cache_version(0);
+			std::uint64_t cached_index_size(0);
+			std::uint64_t cached_index_hash(0);
+			sdsl::read_member(cache_version, stream);
+			sdsl::read_member(cached_index_size, stream);
+			sdsl::read_member(cached_index_hash, stream);
+			
+			if (! (stream &&
+				   STRING_CACHE_VERSION == cache_version &&
+				   index_size == cached_index_size &&
+				   index_hash == cached_index_hash))
+			{
+				return false;
+			}
+		}
+		
+		strings.load(stream);
+		is_unique_sa_order.load(stream);
+		return (stream && strings.size() == is_unique_sa_order.size());
+	}
+	
+	
+	bool store_string_cache(
+		char const *fname,
+		std::uint64_t const index_size,
+		std::uint64_t const index_hash,
+		string_array const &strings,
+		sdsl::bit_vector const &is_unique_sa_order
+	)
+	{
+		// mkstemp needs a writable buffer.
+		std::string const pattern(std::string(fname) + ".XXXXXX");
+		std::vector <char> temp_fname(pattern.cbegin(), pattern.cend());
+		temp_fname.push_back('\0');
+		
+		int const fd(mkstemp(temp_fname.data()));
+		if (-1 == fd)
+			return false;
+		
+		bool status(false);
+		{
+			ios::file_descriptor_sink sink(fd, ios::close_handle);
+			file_ostream stream(sink);
+			
+			std::uint32_t const cache_version(STRING_CACHE_VERSION);
+			sdsl::write_member(cache_version, stream);
+			sdsl::write_member(index_size, stream);
+			sdsl::write_member(index_hash, stream);
+			strings.serialize(stream, nullptr, "strings");
+			is_unique_sa_order.serialize(stream, nullptr, "is_unique_sa_order");
+			stream.flush();
+			status = bool(stream);
+		}
+		
+		if (status && 0 == std::rename(temp_fname.data(), fname))
+			return true;
+		
+		unlink(temp_fname.data());
+		return false;
+	}
+}
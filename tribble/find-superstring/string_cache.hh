@@ -0,0 +1,60 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_STRING_CACHE_HH
+#define TRIBBLE_STRING_CACHE_HH
+
+#include <cstdint>
+#include <istream>
+#include <sdsl/int_vector.hpp>
+#include "string_array.hh"
+
+#define STRING_CACHE_VERSION 1
+
+
+namespace tribble {
+	
+	// The strings returned by check_non_unique_strings() sorted by their
+	// matching suffix lengths and the uniqueness of the strings in suffix
+	// array order depend only on the index, so they may be stored in a file
+	// next to it and reused. The file contains the size and a hash of the
+	// index, and it is ignored if either does not match.
+	
+	// Hash the remaining contents of a memory-mapped stream without moving
+	// its position. Returns false if the stream has not been mapped.
+	bool hash_index(std::istream &index_stream, std::uint64_t &index_size, std::uint64_t &index_hash);
+	
+	// Returns false if the cache does not exist or does not match the index.
+	bool load_string_cache(
+		char const *fname,
+		std::uint64_t const index_size,
+		std::uint64_t const index_hash,
+		/* out */ string_array &strings,
+		/* out */ sdsl::bit_vector &is_unique_sa_order
+	);
+	
+	// Write to a temporary file and replace the cache with it, so that an
+	// incomplete cache is not left behind. Returns false on failure.
+	bool store_string_cache(
+		char const *fname,
+		std::uint64_t const index_size,
+		std::uint64_t const index_hash,
+		string_array const &strings,
+		sdsl::bit_vector const &is_unique_sa_order
+	);
+}
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#include <sdsl/io.hpp>
+#include <stdexcept>
+#include "string_sample_map.hh"
+
+
+namespace tribble {
+	
+	string_sample_map &string_sample_map::operator=(string_sample_map &&other)
+	{
+		if (this != &other)
+		{
+			m_sampled_rows = std::move(other.m_sampled_rows);
+			m_sampled_rows_rank.set_vector(&m_sampled_rows);
+			m_string_indices = std::move(other.m_string_indices);
+			m_sample_rate = other.m_sample_rate;
+		}
+		return *this;
+	}
+	
+	
+	void string_sample_map::store_samples(
+		std::vector <sample_type> const &samples,
+		size_type const size,
+		size_type const string_count,
+		size_type const sample_rate
+	)
+	{
+		sdsl::bit_vector sampled_rows(size, 0);
+		sdsl::int_vector <> string_indices(samples.size(), 0, 1 + sdsl::bits::hi(std::max(size_type(1), string_count)));
+		size_type i(0);
+		for (auto const &sample : samples)
+		{
+			sampled_rows[sample.first] = 1;
+			string_indices[i++] = sample.second;
+		}
+		
+		m_sampled_rows = sdsl::sd_vector <>(sampled_rows);
+		m_sampled_rows_rank.set_vector(&m_sampled_rows);
+		m_string_indices = std::move(string_indices);
+		m_sample_rate = sample_rate;
+	}
+	
+	
+	void string_sample_map::merge(string_sample_map const &old_samples, bwt_merge_row_map const &row_map)
+	{
+		auto const sample_rate(old_samples.m_sample_rate);
+		auto const old_sample_count(old_samples.m_string_indices.size());
+		auto const &rows(row_map.added_rows());
+		
+		std::vector <sample_type> samples;
+		samples.reserve(old_sample_count + rows.size() / sample_rate);
+		
+		// Move the existing samples.
+		{
+			sdsl::sd_vector <>::select_1_type sampled_rows_select(&old_samples.m_sampled_rows);
+			for (size_type i(0); i < old_sample_count; ++i)
+			{
+				auto const row(sampled_rows_select(1 + i));
+				samples.emplace_back(row_map.merged_row(row), row_map.merged_string_index(old_samples.m_string_indices[i]));
+			}
+		}
+		
+		// Sample the added strings.
+		for (size_type i(0), count(rows.size()); i < count; ++i)
+		{
+			auto const &row(rows[i]);
+			if (row.suffix_length && 0 == row.suffix_length % sample_rate)
+				samples.emplace_back(row.old_rank + i, row_map.added_string_index(row.string_idx));
+		}
+		
+		std::sort(samples.begin(), samples.end());
+		store_samples(samples, row_map.size(), row_map.old_string_count() + row_map.added_string_count(), sample_rate);
+	}
+	
+	
+	auto string_sample_map::serialize(
+		std::ostream &out,
+		sdsl::structure_tree_node *v,
+		std::string name
+	) const -> size_type
+	{
+		sdsl::structure_tree_node *child(sdsl::structure_tree::add_child(v, name, "tribble::string_sample_map"));
+		size_type written_bytes(0);
+		
+		written_bytes += sdsl::write_member(m_sample_rate, out, child, "sample_rate");
+		written_bytes += m_sampled_rows.serialize(out, child, "sampled_rows");
+		written_bytes += m_string_indices.serialize(out, child, "string_indices");
+		
+		sdsl::structure_tree::add_size(child, written_bytes);
+		return written_bytes;
+	}
+	
+	
+	void string_sample_map::load(std::istream &in)
+	{
+		sdsl::read_member(m_sample_rate, in);
+		m_sampled_rows.load(in);
+		m_sampled_rows_rank.set_vector(&m_sampled_rows);
+		m_string_indices.load(in);
+		
+		if (0 == m_sample_rate)
+			throw std::runtime_error("Unexpected string sample rate.");
+	}
+}
@@ -0,0 +1,161 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_STRING_SAMPLE_MAP_HH
+#define TRIBBLE_STRING_SAMPLE_MAP_HH
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <sdsl/bits.hpp>
+#include <sdsl/int_vector.hpp>
+#include <sdsl/sd_vector.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+#include "bwt_merge.hh"
+
+
+namespace tribble {
+	
+	// Map a suffix array row to the index of the string that contains its
+	// first character. The rows of the characters whose distance to the end
+	// of their string is a positive multiple of the sample rate are stored in
+	// an Elias-Fano coded bit vector together with the string indices, so any
+	// row may be resolved with less than sample rate applications of psi.
+	class string_sample_map
+	{
+	public:
+		typedef std::size_t size_type;
+		
+	protected:
+		sdsl::sd_vector <>					m_sampled_rows;
+		sdsl::sd_vector <>::rank_1_type		m_sampled_rows_rank;
+		sdsl::int_vector <>					m_string_indices;
+		std::uint64_t						m_sample_rate{1};
+		
+	protected:
+		typedef std::pair <std::uint64_t, std::uint64_t> sample_type;	// Row, string index.
+		
+		// Store the samples sorted by row.
+		void store_samples(std::vector <sample_type> const &samples, size_type const size, size_type const string_count, size_type const sample_rate);
+		
+	public:
+		string_sample_map() = default;
+		string_sample_map(string_sample_map const &) = delete;
+		string_sample_map(string_sample_map &&other) { *this = std::move(other); }
+		
+		string_sample_map &operator=(string_sample_map const &) = delete;
+		string_sample_map &operator=(string_sample_map &&other);
+		
+		// Traverse the text T = #s_1#s_2#…#s_m#$ backwards with LF.
+		template <typename t_csa>
+		void construct(t_csa const &csa, char const sentinel, size_type const string_count, size_type const sample_rate);
+		
+		// Determine the samples of the text to which strings have been added
+		// with merge_bwt from those of the existing text. The existing
+		// sampled rows are moved with the row map and the suffixes of the
+		// added strings are sampled, so the text is not traversed.
+		void merge(string_sample_map const &old_samples, bwt_merge_row_map const &row_map);
+		
+		size_type serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name = "") const;
+		void load(std::istream &in);
+		
+		inline size_type sample_rate() const { return m_sample_rate; }
+		
+		// Find the index of the string that contains the first character of the
+		// given row, which is distance_to_end characters from the separator that
+		// follows the string. Return false if the separator was reached before
+		// a sampled row, in which case row is set to that of the separator.
+		template <typename t_csa>
+		bool find_string(
+			t_csa const &csa,
+			size_type /* inout */ &row,
+			size_type const distance_to_end,
+			size_type /* out */ &string_idx
+		) const;
+	};
+	
+	
+	template <typename t_csa>
+	void string_sample_map::construct(
+		t_csa const &csa,
+		char const sentinel,
+		size_type const string_count,
+		size_type const sample_rate
+	)
+	{
+		assert(sample_rate);
+		auto const size(csa.size());
+		auto const &wt(csa.wavelet_tree);
+		
+		// Start from the row of $, which is the last character, and stop
+		// before the first separator since it does not end any string.
+		std::vector <sample_type> samples;
+		{
+			std::size_t row(0);
+			std::size_t string_idx(string_count);
+			std::size_t distance(0);
+			for (std::size_t text_pos(size - 1); 1 < text_pos; --text_pos)
+			{
+				auto const res(wt.inverse_select(row));
+				row = csa.C[csa.char2comp[res.second]] + res.first;
+				
+				if (sentinel == res.second)
+				{
+					assert(string_idx);
+					--string_idx;
+					distance = 0;
+				}
+				else
+				{
+					++distance;
+					if (0 == distance % sample_rate)
+						samples.emplace_back(row, string_idx);
+				}
+			}
+			assert(0 == string_idx || 0 == string_count);
+		}
+		
+		std::sort(samples.begin(), samples.end());
+		store_samples(samples, size, string_count, sample_rate);
+	}
+	
+	
+	template <typename t_csa>
+	bool string_sample_map::find_string(
+		t_csa const &csa,
+		size_type &row,
+		size_type const distance_to_end,
+		size_type &string_idx
+	) const
+	{
+		// Move to the nearest sampled row or the separator.
+		for (size_type i(0), count(distance_to_end % m_sample_rate); i < count; ++i)
+			row = csa.psi[row];
+		
+		if (distance_to_end < m_sample_rate)
+			return false;
+		
+		assert(m_sampled_rows[row]);
+		string_idx = m_string_indices[m_sampled_rows_rank(row)];
+		return true;
+	}
+}
+
+#endif
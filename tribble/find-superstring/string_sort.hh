@@ -0,0 +1,306 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_STRING_SORT_HH
+#define TRIBBLE_STRING_SORT_HH
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <dispatch/dispatch.h>
+#include <tribble/dispatch_fn.hh>
+#include <utility>
+#include <vector>
+
+
+namespace tribble {
+	
+	// Handle to a string to be sorted. Caches up to eight characters of
+	// the string starting from the current depth rounded down to a multiple
+	// of eight in key and the number of valid characters in the high bits
+	// of the remaining word.
+	class string_sort_item
+	{
+	protected:
+		static constexpr std::size_t const	count_shift{60};
+		static constexpr std::uint64_t const	idx_mask{(UINT64_C(1) << count_shift) - 1};
+		
+		std::uint64_t	m_key{0};
+		std::uint64_t	m_idx_and_count{0};
+		
+	public:
+		string_sort_item() = default;
+		
+		string_sort_item(std::size_t const idx):
+			m_idx_and_count(idx)
+		{
+			assert(idx == (idx & idx_mask));
+		}
+		
+		inline std::size_t idx() const { return m_idx_and_count & idx_mask; }
+		inline std::size_t count() const { return m_idx_and_count >> count_shift; }
+		inline std::uint64_t key() const { return m_key; }
+		
+		// Load the characters starting from key_depth.
+		inline void load_key(std::uint8_t const *data, std::size_t const length, std::size_t const key_depth)
+		{
+			std::size_t const count(key_depth < length ? std::min(std::size_t(8), length - key_depth) : 0);
+			std::uint64_t key(0);
+			for (std::size_t i(0); i < count; ++i)
+				key |= std::uint64_t(data[key_depth + i]) << (8 * (7 - i));
+			
+			m_key = key;
+			m_idx_and_count = idx() | (std::uint64_t(count) << count_shift);
+		}
+		
+		// Get the bucket of the character at the given depth, 0 for the end of the string.
+		inline std::size_t bucket(std::size_t const depth) const
+		{
+			std::size_t const offset(depth % 8);
+			if (count() <= offset)
+				return 0;
+			return 1 + ((m_key >> (8 * (7 - offset))) & 0xff);
+		}
+	};
+	
+	
+	// Sort strings lexicographically with a multi-threaded MSD radix sort.
+	// t_access is called with a string index and should return a pair of
+	// the string's data pointer and length. The strings need to remain
+	// unchanged while sorting. Equal strings are placed next to each other.
+	template <typename t_access>
+	class string_sorter
+	{
+	protected:
+		enum { BUCKET_COUNT = 257 };
+		
+		struct task
+		{
+			string_sort_item	*begin{nullptr};
+			string_sort_item	*end{nullptr};
+			std::size_t			depth{0};
+			
+			task() = default;
+			
+			task(string_sort_item *begin_, string_sort_item *end_, std::size_t const depth_):
+				begin(begin_),
+				end(end_),
+				depth(depth_)
+			{
+			}
+			
+			inline std::size_t size() const { return end - begin; }
+		};
+		
+		typedef std::array <std::size_t, 1 + BUCKET_COUNT> bucket_array;
+		
+	protected:
+		t_access		m_access;
+		std::size_t		m_worker_count{1};
+		std::size_t		m_small_range_size{32};
+		
+	protected:
+		inline void load_key(string_sort_item &item, std::size_t const key_depth) const
+		{
+			auto const pair(m_access(item.idx()));
+			item.load_key(pair.first, pair.second, key_depth);
+		}
+		
+		// Compare two strings that have equal prefixes before the key depth.
+		inline bool is_less(string_sort_item const &lhs, string_sort_item const &rhs, std::size_t const key_depth) const
+		{
+			if (lhs.key() != rhs.key())
+				return lhs.key() < rhs.key();
+			
+			if (lhs.count() != rhs.count())
+				return lhs.count() < rhs.count();
+			
+			// The strings end at the same position.
+			if (lhs.count() < 8)
+				return false;
+			
+			// Compare the remaining characters.
+			auto const lhs_pair(m_access(lhs.idx()));
+			auto const rhs_pair(m_access(rhs.idx()));
+			std::size_t const tail_depth(8 + key_depth);
+			assert(tail_depth <= lhs_pair.second);
+			assert(tail_depth <= rhs_pair.second);
+			auto const lhs_length(lhs_pair.second - tail_depth);
+			auto const rhs_length(rhs_pair.second - tail_depth);
+			auto const res(std::memcmp(lhs_pair.first + tail_depth, rhs_pair.first + tail_depth, std::min(lhs_length, rhs_length)));
+			if (res)
+				return res < 0;
+			return lhs_length < rhs_length;
+		}
+		
+		// Distribute the items in the given range to buckets by the character at the given depth
+		// using the in-place American flag sort permutation.
+		void distribute(task const &current, bucket_array &bucket_starts) const
+		{
+			bucket_array bucket_ends;
+			std::fill(bucket_starts.begin(), bucket_starts.end(), 0);
+			
+			for (auto it(current.begin); it != current.end; ++it)
+				++bucket_starts[1 + it->bucket(current.depth)];
+			
+			// Convert the counts to positions.
+			for (std::size_t i(1); i < bucket_starts.size(); ++i)
+				bucket_starts[i] += bucket_starts[i - 1];
+			std::copy(bucket_starts.begin(), bucket_starts.end(), bucket_ends.begin());
+			
+			// Move each item to its bucket.
+			for (std::size_t i(0); i < BUCKET_COUNT; ++i)
+			{
+				auto &next(bucket_ends[i]);
+				while (next < bucket_starts[1 + i])
+				{
+					auto item(current.begin[next]);
+					auto bucket(item.bucket(current.depth));
+					while (bucket != i)
+					{
+						std::swap(item, current.begin[bucket_ends[bucket]++]);
+						bucket = item.bucket(current.depth);
+					}
+					current.begin[next++] = item;
+				}
+			}
+		}
+		
+		// Handle one range and add the sub-ranges to be handled to the given vector.
+		void sort_range(task const &current, std::vector <task> &tasks) const
+		{
+			// Load the next characters if needed.
+			if (current.depth && 0 == current.depth % 8)
+			{
+				for (auto it(current.begin); it != current.end; ++it)
+					load_key(*it, current.depth);
+			}
+			
+			if (current.size() <= m_small_range_size)
+			{
+				std::size_t const key_depth(current.depth - current.depth % 8);
+				std::sort(current.begin, current.end, [this, key_depth](auto const &lhs, auto const &rhs) {
+					return is_less(lhs, rhs, key_depth);
+				});
+				return;
+			}
+			
+			bucket_array bucket_starts;
+			distribute(current, bucket_starts);
+			
+			// Bucket zero contains equal strings that end at the current depth.
+			for (std::size_t i(1); i < BUCKET_COUNT; ++i)
+			{
+				auto const begin(bucket_starts[i]);
+				auto const end(bucket_starts[1 + i]);
+				if (1 < end - begin)
+					tasks.emplace_back(current.begin + begin, current.begin + end, 1 + current.depth);
+			}
+		}
+		
+		void sort_sequentially(task const &initial_task) const
+		{
+			std::vector <task> tasks;
+			tasks.push_back(initial_task);
+			while (!tasks.empty())
+			{
+				auto const current(tasks.back());
+				tasks.pop_back();
+				sort_range(current, tasks);
+			}
+		}
+		
+	public:
+		string_sorter(t_access access, std::size_t const worker_count):
+			m_access(std::move(access)),
+			m_worker_count(std::max(std::size_t(1), worker_count))
+		{
+		}
+		
+		// Fill items with 0, 1, …, string_count - 1 and sort.
+		void sort(std::size_t const string_count, std::vector <string_sort_item> &items) const
+		{
+			items.resize(string_count);
+			if (0 == string_count)
+				return;
+			
+			dispatch_queue_t queue(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+			
+			// Load the first characters in blocks.
+			{
+				std::size_t const block_size(1 + (string_count - 1) / m_worker_count);
+				dispatch_apply_fn(m_worker_count, queue, [this, &items, string_count, block_size](std::size_t const i) {
+					auto const limit(std::min(string_count, (1 + i) * block_size));
+					for (std::size_t j(i * block_size); j < limit; ++j)
+					{
+						string_sort_item item(j);
+						load_key(item, 0);
+						items[j] = item;
+					}
+				});
+			}
+			
+			// Split the ranges sequentially until they are small enough to be
+			// distributed to the workers.
+			std::vector <task> small_tasks;
+			{
+				std::size_t const parallel_range_size(std::max(m_small_range_size, string_count / (8 * m_worker_count)));
+				std::vector <task> tasks;
+				tasks.emplace_back(items.data(), items.data() + string_count, 0);
+				while (!tasks.empty())
+				{
+					auto const current(tasks.back());
+					tasks.pop_back();
+					
+					if (1 == m_worker_count || current.size() <= parallel_range_size)
+						small_tasks.push_back(current);
+					else
+						sort_range(current, tasks);
+				}
+			}
+			
+			// Handle the larger ranges first.
+			std::sort(small_tasks.begin(), small_tasks.end(), [](task const &lhs, task const &rhs) {
+				return lhs.size() > rhs.size();
+			});
+			
+			std::atomic_size_t next_task(0);
+			dispatch_apply_fn(m_worker_count, queue, [this, &small_tasks, &next_task](std::size_t const) {
+				auto const task_count(small_tasks.size());
+				while (true)
+				{
+					auto const idx(next_task++);
+					if (task_count <= idx)
+						break;
+					
+					sort_sequentially(small_tasks[idx]);
+				}
+			});
+		}
+	};
+	
+	
+	template <typename t_access>
+	string_sorter <t_access> make_string_sorter(t_access access, std::size_t const worker_count)
+	{
+		return string_sorter <t_access>(std::move(access), worker_count);
+	}
+}
+
+#endif
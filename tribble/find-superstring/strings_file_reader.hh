@@ -0,0 +1,82 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_STRINGS_FILE_READER_HH
+#define TRIBBLE_STRINGS_FILE_READER_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <tribble/mapped_file.hh>
+#include "packed_strings.hh"
+
+
+namespace tribble {
+	
+	// Read the strings of an existing strings file in the plain format,
+	// i.e. the strings preceded and followed by the sentinel, in order.
+	class strings_file_reader
+	{
+	protected:
+		std::uint8_t const	*m_data{nullptr};
+		std::uint8_t const	*m_end{nullptr};
+		std::uint8_t		m_sentinel{};
+		
+	public:
+		strings_file_reader(mapped_file const &file, char const sentinel):
+			m_data(reinterpret_cast <std::uint8_t const *>(file.data())),
+			m_end(m_data + file.size()),
+			m_sentinel(sentinel)
+		{
+			if (m_data != m_end && m_sentinel != *m_data)
+				throw std::runtime_error("The strings file does not begin with the sentinel.");
+		}
+		
+		// Use the first character of the file as the sentinel.
+		explicit strings_file_reader(mapped_file const &file):
+			m_data(reinterpret_cast <std::uint8_t const *>(file.data())),
+			m_end(m_data + file.size())
+		{
+			std::uint32_t const magic(packed_strings::MAGIC);
+			if (sizeof(magic) <= file.size() && 0 == std::memcmp(m_data, &magic, sizeof(magic)))
+				throw std::runtime_error("Strings files in the packed format may not be read as sorted strings.");
+			
+			if (m_data != m_end)
+				m_sentinel = *m_data;
+		}
+		
+		inline char sentinel() const { return m_sentinel; }
+		
+		// Get the next string. The final sentinel is not followed by one.
+		bool read_next(std::uint8_t const *&data, std::size_t &length)
+		{
+			if (m_end - m_data < 2)
+				return false;
+			
+			data = m_data + 1;
+			auto const *end(std::find(data, m_end, m_sentinel));
+			if (end == m_end)
+				throw std::runtime_error("The strings file does not end with the sentinel.");
+			
+			length = end - data;
+			m_data = end;
+			return true;
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,177 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_STRINGS_WRITER_HH
+#define TRIBBLE_STRINGS_WRITER_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <sdsl/int_vector.hpp>
+#include <sdsl/util.hpp>
+#include <stdexcept>
+
+
+namespace tribble {
+	
+	// Write the sorted strings to the strings file separated by the sentinel
+	// and record their lengths. The caller is responsible for passing each
+	// unique string exactly once in lexicographic order. If a text buffer
+	// is given, the concatenation is built in memory and written to the
+	// stream in one piece when finishing. The lengths are stored at the
+	// width of the longest string so far.
+	class strings_writer
+	{
+	protected:
+		std::ostream			*m_stream{nullptr};
+		sdsl::int_vector <8>	*m_text{nullptr};
+		sdsl::int_vector <>		m_string_lengths = sdsl::int_vector <>(0, 0, 1);
+		std::size_t				m_string_count{0};
+		std::size_t				m_text_size{0};
+		char					m_sentinel{};
+		
+	protected:
+		void handle_sentinel_in_text()
+		{
+			throw std::runtime_error("The text contains the sentinel character.");
+		}
+		
+		void handle_zero_in_text()
+		{
+			throw std::runtime_error("The text contains the zero character.");
+		}
+		
+		void append_to_text(char const *begin, std::size_t const length)
+		{
+			auto const required(m_text_size + 1 + length);
+			if (m_text->size() < required)
+				m_text->resize(std::max(2 * m_text->size(), required));
+			
+			// The elements of int_vector <8> are stored as consecutive bytes.
+			auto *dst(reinterpret_cast <char *>(m_text->data()) + m_text_size);
+			*dst = m_sentinel;
+			std::copy_n(begin, length, dst + 1);
+			m_text_size = required;
+		}
+		
+		static inline std::uint8_t length_width(std::size_t const length)
+		{
+			return 1 + sdsl::bits::hi(length | 0x1);
+		}
+		
+		void resize_lengths(std::size_t const size, std::uint8_t const width)
+		{
+			sdsl::int_vector <> lengths(size, 0, width);
+			std::copy_n(m_string_lengths.begin(), m_string_count, lengths.begin());
+			m_string_lengths.swap(lengths);
+		}
+		
+		void append_length(std::size_t const length)
+		{
+			auto const width(std::max(m_string_lengths.width(), length_width(length)));
+			auto const size(m_string_lengths.size());
+			if (size == m_string_count)
+				resize_lengths(std::max(std::size_t(1024), 2 * size), width);
+			else if (m_string_lengths.width() < width)
+				resize_lengths(size, width);
+			
+			m_string_lengths[m_string_count++] = length;
+		}
+		
+	public:
+		strings_writer(std::ostream &stream, char const sentinel):
+			m_stream(&stream),
+			m_sentinel(sentinel)
+		{
+		}
+		
+		// Build the text in the given vector. The expected size is used
+		// for allocating the buffer.
+		strings_writer(std::ostream &stream, char const sentinel, sdsl::int_vector <8> &text, std::size_t const expected_size):
+			m_stream(&stream),
+			m_text(&text),
+			m_sentinel(sentinel)
+		{
+			m_text->resize(expected_size);
+		}
+		
+		inline std::size_t string_count() const { return m_string_count; }
+		
+		// Allocate space for the lengths of the given number of strings.
+		void reserve(std::size_t const string_count, std::size_t const max_length)
+		{
+			auto const width(std::max(m_string_lengths.width(), length_width(max_length)));
+			if (m_string_lengths.size() < string_count || m_string_lengths.width() < width)
+				resize_lengths(std::max(m_string_lengths.size(), string_count), width);
+		}
+		
+		// The memory needed for the lengths of the given number of strings.
+		static inline std::size_t length_memory(std::size_t const string_count, std::size_t const max_length)
+		{
+			return (string_count * length_width(max_length) + 63) / 64 * sizeof(std::uint64_t);
+		}
+		
+		void add(std::uint8_t const *data, std::size_t const length)
+		{
+			auto const *begin(reinterpret_cast <char const *>(data));
+			auto const *end(begin + length);
+			
+			// Check for the sentinel.
+			if (end != std::find(begin, end, m_sentinel))
+				handle_sentinel_in_text();
+			
+			// SDSL's suffix array construction uses zero as the terminator.
+			if (m_text && end != std::find(begin, end, 0))
+				handle_zero_in_text();
+			
+			if (m_text)
+				append_to_text(begin, length);
+			else
+			{
+				m_stream->put(m_sentinel);
+				m_stream->write(begin, length);
+			}
+			append_length(length);
+		}
+		
+		// Output the final sentinel and get the string lengths.
+		// If the text was built in memory, it will be terminated with
+		// a zero as expected by SDSL's suffix array construction.
+		void finish(sdsl::int_vector <> /* out */ &string_lengths)
+		{
+			if (m_text)
+			{
+				if (m_string_count)
+					append_to_text(nullptr, 0);
+				
+				m_stream->write(reinterpret_cast <char const *>(m_text->data()), m_text_size);
+				m_text->resize(1 + m_text_size);
+				(*m_text)[m_text_size] = 0;
+			}
+			else if (m_string_count)
+			{
+				m_stream->put(m_sentinel);
+			}
+			m_stream->flush();
+			
+			m_string_lengths.resize(m_string_count);
+			sdsl::util::bit_compress(m_string_lengths);
+			string_lengths = std::move(m_string_lengths);
+		}
+	};
+}
+
+#endif
@@ -254,6 +254,34 @@ void Superstring_callback::do_path(int64_t start_string, std::ostream& out, sdsl
 	}
 }
 
+void Superstring_callback::write_string(packed_strings const& strings, int64_t string_idx, int64_t skip, std::ostream& out){
+	if (! (string_idx < strings.string_count()))
+	{
+		std::cerr << "String index: " << string_idx << ", string count: " << strings.string_count() << std::endl;
+		throw std::runtime_error("String index out of bounds");
+	}
+	
+	// The string may be located directly.
+	auto const begin = strings.string_begin(string_idx);
+	auto const length = strings.string_length(string_idx);
+	for(std::size_t k = skip; k < length; k++)
+		out.put(strings.character(begin + k));
+}
+
+void Superstring_callback::do_path(int64_t start_string, std::ostream& out, packed_strings const& strings){
+	write_string(strings, start_string, 0, out);
+	
+	int64_t current_string_idx = start_string;
+	while(string_successor[current_string_idx] != n_strings){
+		int64_t left_string = current_string_idx;
+		int64_t right_string = string_successor[current_string_idx];
+		int64_t overlap = overlap_lengths[left_string];
+		
+		write_string(strings, right_string, overlap, out);
+		current_string_idx = right_string;
+	}
+}
+
 void Superstring_callback::finish_matching(){
 	// Free data structures.
 	{
@@ -270,6 +298,21 @@ void Superstring_callback::build_final_superstring(std::ostream& out){
 	// separated by the '#' character i.e.
 	// #s1#s2#s3#s3#s4#s5#s6#
 	
+	// If the strings file is in the packed format, the strings need not be read
+	// in advance.
+	if(packed_strings::is_packed(*strings_stream)){
+		packed_strings strings;
+		strings.load(*strings_stream);
+		if(strings.string_count() != n_strings)
+			throw std::runtime_error("The number of strings in the strings file does not match the index");
+		
+		for(std::size_t i = 0; i < n_strings; i++){
+			if(rightavailable[i])
+				do_path(i, out, strings);
+		}
+		return;
+	}
+	
 	// Read the strings from the input stream given earlier with set_strings_stream
 	sdsl::int_vector<0> concatenation; // Reading the contents of the input stream into here
 	concatenation.width(1 + sdsl::bits::hi(alphabet.sigma));
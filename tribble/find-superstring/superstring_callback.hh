@@ -23,6 +23,7 @@
 #include <string>
 #include <tuple>
 #include "find_superstring.hh"
+#include "packed_strings.hh"
 #include "union_find.hh"
 
 
@@ -67,6 +68,10 @@ namespace tribble {
 		// Writes to 'out' the chained merge of all reads on the path starting from 'start_string'
 		void do_path(int64_t start_string, std::ostream& out, sdsl::int_vector<0>& concatenation, sdsl::int_vector<0>& string_start_points);
 		
+		// As above but with the strings stored in the packed format
+		void write_string(packed_strings const& strings, int64_t string_idx, int64_t skip, std::ostream& out);
+		void do_path(int64_t start_string, std::ostream& out, packed_strings const& strings);
+		
 		UnionFind UF; // For finding the next one-bit in rightavailable quickly. See paper.
 		
 		std::size_t merges_done; // Number of merges done by try_merge
@@ -0,0 +1,542 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <sdsl/io.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <tribble/io.hh>
+#include <tribble/mapped_file.hh>
+#include "bwt_merge.hh"
+#include "construct_cst.hh"
+#include "find_superstring.hh"
+#include "packed_strings.hh"
+#include "read_sequences.hh"
+#include "sequence_store.hh"
+#include "string_sort.hh"
+#include "strings_file_reader.hh"
+#include "strings_writer.hh"
+#include "timer.hh"
+
+
+namespace tribble { namespace detail {
+	
+	// Determine the SA and ISA samples of the merged text from the CSA of the
+	// existing text and the row map produced by merge_bwt instead of
+	// traversing the merged text with LF. The position of a sampled existing
+	// row is found by moving forward with psi to the terminator of its
+	// string, and the row of a sampled position in an existing string by
+	// moving from the nearer end of the string, so the number of steps per
+	// sample is bounded by the length of the string.
+	template <typename t_csa>
+	void merge_csa_samples(
+		t_csa const &old_csa,
+		bwt_merge_row_map const &row_map,
+		sdsl::int_vector <> const &string_lengths,
+		sdsl::int_vector <> &sa_samples,
+		sdsl::int_vector <> &isa_samples
+	)
+	{
+		typedef bwt_merge_row_map::size_type size_type;
+		
+		size_type const sa_sample_dens(t_csa::sa_sample_dens);
+		size_type const isa_sample_dens(t_csa::isa_sample_dens);
+		auto const size(row_map.size());
+		auto const old_string_count(row_map.old_string_count());
+		auto const added_string_count(row_map.added_string_count());
+		auto const string_count(string_lengths.size());
+		auto const &rows(row_map.added_rows());
+		assert(old_csa.size() == row_map.old_size());
+		assert(string_count == old_string_count + added_string_count);
+		
+		// Positions of the strings in the merged text #s_1#…#s_m#$.
+		std::uint8_t const width(1 + sdsl::bits::hi(size));
+		sdsl::int_vector <> string_starts(string_count, 0, width);
+		{
+			size_type pos(1);
+			for (size_type i(0); i < string_count; ++i)
+			{
+				string_starts[i] = pos;
+				pos += 1 + string_lengths[i];
+			}
+			assert(1 + pos == size);
+		}
+		
+		// Row 0 is that of $ and row 2 that of the first terminator. Of the
+		// rows of the other terminators, row 1 is followed by $ and thus ends
+		// the last string, and row 3 + i ends string i.
+		auto const merged_text_position([&old_csa, &row_map, &string_starts, &string_lengths, size, old_string_count](size_type row) -> size_type {
+			if (0 == row)
+				return size - 1;
+			if (2 == row)
+				return 0;
+			
+			size_type distance(0);
+			while (! (1 == row || (3 <= row && row <= 1 + old_string_count)))
+			{
+				row = old_csa.psi[row];
+				++distance;
+			}
+			
+			auto const string_idx(row_map.merged_string_index(1 == row ? old_string_count - 1 : row - 3));
+			return string_starts[string_idx] + string_lengths[string_idx] - distance;
+		});
+		
+		{
+			auto event(sdsl::memory_monitor::event("merge SA samples"));
+			sa_samples.width(width);
+			sa_samples.resize((size + sa_sample_dens - 1) / sa_sample_dens);
+			
+			size_type added_idx(0);
+			for (size_type row(0); row < size; row += sa_sample_dens)
+			{
+				// Count the added rows that precede the current one.
+				while (added_idx < rows.size() && rows[added_idx].old_rank + added_idx < row)
+					++added_idx;
+				
+				if (added_idx < rows.size() && rows[added_idx].old_rank + added_idx == row)
+				{
+					auto const &added_row(rows[added_idx]);
+					auto const string_idx(row_map.added_string_index(added_row.string_idx));
+					sa_samples[row / sa_sample_dens] = string_starts[string_idx] + string_lengths[string_idx] - added_row.suffix_length;
+				}
+				else
+				{
+					sa_samples[row / sa_sample_dens] = merged_text_position(row_map.old_row(row, added_idx));
+				}
+			}
+		}
+		
+		{
+			auto event(sdsl::memory_monitor::event("merge ISA samples"));
+			isa_samples.width(width);
+			isa_samples.resize((size - 1) / isa_sample_dens + 1);
+			
+			size_type string_idx(0);
+			size_type added_string_idx(0);
+			for (size_type pos(0); pos < size; pos += isa_sample_dens)
+			{
+				size_type row(0);
+				if (0 == pos)
+					row = 2;
+				else if (size - 1 == pos)
+					row = 0;
+				else
+				{
+					// Find the string that contains the position or is followed
+					// by the terminator at the position.
+					while (1 + string_idx < string_count && string_starts[1 + string_idx] <= pos)
+						++string_idx;
+					while (added_string_idx < added_string_count && row_map.added_string_index(added_string_idx) < string_idx)
+						++added_string_idx;
+					
+					auto const offset(pos - string_starts[string_idx]);
+					auto const length(string_lengths[string_idx]);
+					assert(offset <= length);
+					if (added_string_idx < added_string_count && row_map.added_string_index(added_string_idx) == string_idx)
+						row = row_map.added_row(added_string_idx, length - offset);
+					else
+					{
+						// Move from the terminator that precedes the string, the row
+						// of which is 2 + i, or from the one that follows it.
+						auto const old_string_idx(string_idx - added_string_idx);
+						size_type old_row(0);
+						if (offset < length - offset)
+						{
+							old_row = 2 + old_string_idx;
+							for (size_type i(0); i <= offset; ++i)
+								old_row = old_csa.psi[old_row];
+						}
+						else
+						{
+							old_row = (1 + old_string_idx == old_string_count ? 1 : 3 + old_string_idx);
+							for (size_type i(offset); i < length; ++i)
+								old_row = old_csa.lf[old_row];
+						}
+						row = row_map.merged_row(old_row);
+					}
+				}
+				
+				isa_samples[pos / isa_sample_dens] = row;
+			}
+		}
+	}
+	
+	
+	class update_index_cb
+	{
+	public:
+		typedef vector_source::vector_type vector_type;
+		
+	protected:
+		std::istream &m_base_index_stream;
+		std::ostream &m_index_stream;
+		std::ostream &m_strings_stream;
+		mapped_file m_base_strings;
+		sequence_store m_sequences;
+		std::vector <string_sort_item> m_sorted_sequences;
+		timer m_read_timer{};
+		std::size_t m_thread_count{1};
+		uint32_t m_seqno{0};
+		
+	protected:
+		inline static bool sequence_less(
+			std::uint8_t const *lhs,
+			std::size_t const lhs_length,
+			std::uint8_t const *rhs,
+			std::size_t const rhs_length
+		)
+		{
+			auto const res(std::memcmp(lhs, rhs, std::min(lhs_length, rhs_length)));
+			if (res)
+				return res < 0;
+			return lhs_length < rhs_length;
+		}
+		
+		void sort_sequences()
+		{
+			auto const sorter(make_string_sorter([this](std::size_t const idx) {
+				return m_sequences[idx];
+			}, m_thread_count));
+			sorter.sort(m_sequences.size(), m_sorted_sequences);
+		}
+		
+		// Merge the added sequences to the existing strings and write the
+		// union to the strings file. Store the added strings with the
+		// numbers of the existing strings that precede them.
+		void merge_strings(
+			char const sentinel,
+			strings_writer &writer,
+			std::vector <bwt_merge_string> &added_strings,
+			std::size_t &old_string_count,
+			sequence_store::sequence_type &last_string
+		)
+		{
+			strings_file_reader reader(m_base_strings, sentinel);
+			std::uint8_t const *old_data(nullptr);
+			std::size_t old_length(0);
+			bool has_old(reader.read_next(old_data, old_length));
+			
+			bool has_previous(false);
+			std::size_t previous_idx(0);
+			for (auto const &item : m_sorted_sequences)
+			{
+				auto const idx(item.idx());
+				if (has_previous && m_sequences.is_equal(idx, previous_idx))
+					continue;
+				previous_idx = idx;
+				has_previous = true;
+				
+				auto const seq(m_sequences[idx]);
+				if (seq.first + seq.second != std::find(seq.first, seq.first + seq.second, 0))
+					throw std::runtime_error("The text contains the zero character.");
+				
+				// Copy the smaller existing strings.
+				while (has_old && sequence_less(old_data, old_length, seq.first, seq.second))
+				{
+					writer.add(old_data, old_length);
+					last_string = sequence_store::sequence_type(old_data, old_length);
+					++old_string_count;
+					has_old = reader.read_next(old_data, old_length);
+				}
+				
+				// Skip the strings that are already in the index.
+				if (has_old && old_length == seq.second && 0 == std::memcmp(old_data, seq.first, old_length))
+					continue;
+				
+				writer.add(seq.first, seq.second);
+				added_strings.emplace_back(seq.first, seq.second, old_string_count);
+			}
+			
+			while (has_old)
+			{
+				writer.add(old_data, old_length);
+				last_string = sequence_store::sequence_type(old_data, old_length);
+				++old_string_count;
+				has_old = reader.read_next(old_data, old_length);
+			}
+		}
+		
+		template <typename t_policy>
+		void merge_and_serialize_index()
+		{
+			typedef typename t_policy::cst_type cst_type;
+			
+			index_type <t_policy> base_index;
+			std::cerr << "Loading the index…" << std::flush;
+			{
+				timer timer;
+				
+				base_index.load(m_base_index_stream);
+				
+				timer.stop();
+				std::cerr << " finished in " << timer.ms_elapsed() << " ms." << std::endl;
+			}
+			
+			std::vector <bwt_merge_string> added_strings;
+			std::size_t old_string_count(0);
+			sequence_store::sequence_type last_string(nullptr, 0);
+			sdsl::int_vector <> string_lengths;
+			std::cerr << "Merging the strings…" << std::flush;
+			{
+				timer timer;
+				
+				strings_writer writer(m_strings_stream, base_index.sentinel);
+				merge_strings(base_index.sentinel, writer, added_strings, old_string_count, last_string);
+				writer.finish(string_lengths);
+				
+				timer.stop();
+				std::cerr << " finished in " << timer.ms_elapsed() << " ms, added " << added_strings.size() << " unique strings." << std::endl;
+			}
+			
+			if (old_string_count != base_index.string_lengths.size())
+				throw std::runtime_error("The strings file does not match the index.");
+			if (0 == old_string_count)
+				throw std::runtime_error("The index does not contain any strings.");
+			
+			// Merge the BWTs. The SA and ISA samples as well as the string
+			// samples are updated with the resulting row map unless the
+			// strings are long compared to the sample density, in which case
+			// traversing the merged text is faster. The rest of the CST is
+			// rebuilt from the merged BWT. Keep the intermediate files in
+			// SDSL's RAM file system.
+			typedef typename cst_type::csa_type csa_type;
+			sdsl::cache_config config(true, "@");
+			bwt_merge_row_map row_map;
+			sdsl::int_vector <> sa_samples;
+			sdsl::int_vector <> isa_samples;
+			bool const should_merge_csa_samples(
+				base_index.cst.csa.size() <= old_string_count * std::min <std::size_t>(csa_type::sa_sample_dens, csa_type::isa_sample_dens)
+			);
+			{
+				sdsl::int_vector <8> bwt;
+				construction_step("Merging the BWT", [&base_index, &added_strings, &bwt, &row_map, old_string_count, &last_string](){
+					merge_bwt(
+						base_index.cst.csa.wavelet_tree,
+						old_string_count,
+						last_string.first,
+						last_string.second,
+						added_strings,
+						bwt,
+						row_map
+					);
+				});
+				
+				if (should_merge_csa_samples)
+				{
+					construction_step("Updating the SA and ISA samples", [&base_index, &row_map, &string_lengths, &sa_samples, &isa_samples](){
+						merge_csa_samples(base_index.cst.csa, row_map, string_lengths, sa_samples, isa_samples);
+					});
+				}
+				
+				// The existing CST is no longer needed.
+				{
+					cst_type empty;
+					base_index.cst.swap(empty);
+				}
+				
+				sdsl::store_to_cache(bwt, sdsl::conf::KEY_BWT, config);
+			}
+			
+			// The added strings refer to the sequences and the existing strings to the mapping.
+			{
+				decltype(added_strings) empty_added;
+				decltype(m_sorted_sequences) empty_sorted;
+				added_strings.swap(empty_added);
+				m_sorted_sequences.swap(empty_sorted);
+				m_sequences.free();
+				m_base_strings.close();
+			}
+			
+			std::cerr << "Updating the CST." << std::endl;
+			cst_type cst;
+			{
+				timer timer;
+				
+				if (should_merge_csa_samples)
+				{
+					construction_step("Constructing the CSA", [&config, &sa_samples, &isa_samples](){
+						construct_csa_from_bwt <csa_type>(config, sa_samples, isa_samples);
+					});
+				}
+				
+				// Construct with LCP if assertions have been enabled.
+				// The LCP array and the tree are rebuilt from the whole BWT.
+				construct_cst_from_bwt(config, TRIBBLE_ASSERTIONS_ENABLED, cst);
+				check_sentinel(cst, base_index.sentinel);
+				
+				timer.stop();
+				std::cerr << "Updated the CST in " << timer.ms_elapsed() << " ms." << std::endl;
+			}
+			
+			string_sample_map string_samples;
+			construction_step("Updating the string samples", [&base_index, &row_map, &string_samples](){
+				string_samples.merge(base_index.string_samples, row_map);
+			});
+			
+			// Serialize.
+			std::cerr << "Serializing…" << std::flush;
+			{
+				timer timer;
+				
+				index_type <t_policy> index(cst, string_lengths, string_samples, base_index.sentinel);
+				sdsl::serialize(index, m_index_stream);
+				
+				timer.stop();
+				std::cerr << " finished in " << timer.ms_elapsed() << " ms." << std::endl;
+			}
+		}
+		
+	public:
+		update_index_cb(
+			std::istream &base_index_stream,
+			char const *base_strings_fname,
+			std::ostream &index_stream,
+			std::ostream &strings_stream,
+			std::size_t const thread_count
+		):
+			m_base_index_stream(base_index_stream),
+			m_index_stream(index_stream),
+			m_strings_stream(strings_stream),
+			m_thread_count(thread_count)
+		{
+			assert(base_strings_fname);
+			open_file_for_reading(base_strings_fname, m_base_strings);
+			
+			// The strings are merged in their plain form.
+			if (m_base_strings.size() && std::uint8_t(packed_strings::MAGIC & 0xff) == std::uint8_t(m_base_strings.data()[0]))
+				throw std::runtime_error("The base strings file is in the packed format.");
+		}
+		
+		// For FASTA.
+		void handle_sequence(
+			std::string const &identifier,
+			std::unique_ptr <vector_type> &seq,
+			std::size_t const seq_length,
+			vector_source &vs
+		)
+		{
+			m_sequences.push_back(reinterpret_cast <std::uint8_t const *>(seq->data()), seq_length);
+			vs.put_vector(seq);
+			++m_seqno;
+			
+			if (0 == m_seqno % 10000)
+				std::cerr << " " << m_seqno << std::flush;
+		}
+		
+		// For FASTA in a mapped file.
+		void handle_sequence(
+			std::string const &identifier,
+			std::uint8_t const *data,
+			std::size_t const seq_length
+		)
+		{
+			m_sequences.push_back(data, seq_length);
+			++m_seqno;
+			
+			if (0 == m_seqno % 10000)
+				std::cerr << " " << m_seqno << std::flush;
+		}
+		
+		// For line-oriented text.
+		void handle_sequence(
+			uint32_t const lineno,
+			std::unique_ptr <vector_type> &seq,
+			std::size_t const seq_length,
+			vector_source &vs
+		)
+		{
+			m_sequences.push_back(reinterpret_cast <std::uint8_t const *>(seq->data()), seq_length);
+			vs.put_vector(seq);
+			
+			if (0 == lineno % 10000)
+				std::cerr << " " << lineno << std::flush;
+		}
+		
+		// For line-oriented text in a mapped file.
+		void handle_sequence(
+			uint32_t const lineno,
+			std::uint8_t const *data,
+			std::size_t const seq_length
+		)
+		{
+			m_sequences.push_back(data, seq_length);
+			
+			if (0 == lineno % 10000)
+				std::cerr << " " << lineno << std::flush;
+		}
+		
+		void finish()
+		{
+			{
+				m_read_timer.stop();
+				std::cerr << " finished in " << m_read_timer.ms_elapsed() << " ms, read " << m_sequences.size() << " sequences." << std::endl;
+			}
+			
+			std::cerr << "Sorting the sequences…" << std::flush;
+			{
+				timer timer;
+				
+				sort_sequences();
+				
+				timer.stop();
+				std::cerr << " finished in " << timer.ms_elapsed() << " ms." << std::endl;
+			}
+			
+			// Update the index with the configuration and the sampling of the existing one.
+			auto const tag(read_index_header(m_base_index_stream));
+			dispatch_index_configuration(tag, [this](auto const &policy){
+				typedef std::decay_t <decltype(policy)> policy_type;
+				merge_and_serialize_index <policy_type>();
+			});
+		}
+	};
+}}
+
+
+namespace tribble {
+	
+	void update_index(
+		char const *source_fname,
+		std::istream &base_index_stream,
+		char const *base_strings_fname,
+		std::ostream &index_stream,
+		std::ostream &strings_stream,
+		enum_source_format const source_format,
+		std::size_t const thread_count,
+		error_handler &error_handler
+	)
+	{
+		try
+		{
+			// Read the added sequences and update the index in the callback.
+			std::cerr << "Reading the sequences…" << std::flush;
+			detail::update_index_cb cb(base_index_stream, base_strings_fname, index_stream, strings_stream, thread_count);
+			read_sequences(source_fname, source_format, thread_count, cb);
+		}
+		catch (std::exception const &exc)
+		{
+			error_handler.handle_exception(exc);
+		}
+		catch (...)
+		{
+			error_handler.handle_unknown_exception();
+		}
+	}
+}
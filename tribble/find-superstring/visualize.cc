@@ -21,8 +21,8 @@ namespace tribble {
 
 	void visualize(std::istream &stream, std::ostream &memory_chart_stream)
 	{
-		index_type index;
-		index.load(stream);
-		sdsl::write_structure <sdsl::HTML_FORMAT>(index, memory_chart_stream);
+		load_index(stream, [&memory_chart_stream](auto const &index){
+			sdsl::write_structure <sdsl::HTML_FORMAT>(index, memory_chart_stream);
+		});
 	}
 }
@@ -0,0 +1,110 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_DECOMPRESSING_ISTREAM_HH
+#define TRIBBLE_DECOMPRESSING_ISTREAM_HH
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <istream>
+#include <mutex>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+
+namespace tribble {
+	
+	enum class compression_type
+	{
+		NONE,
+		GZIP,
+		BZIP2
+	};
+	
+	
+	// Determine the compression from the first bytes of a file.
+	compression_type detect_compression(char const *magic, std::size_t const size);
+	
+	
+	// A stream buffer that reads a file, decompressing it if needed, in a
+	// separate thread. The decompressed data are passed to the reading thread
+	// in blocks through a ring buffer, so decompression overlaps with parsing.
+	class decompressing_streambuf : public std::streambuf
+	{
+	protected:
+		enum : std::size_t
+		{
+			BLOCK_COUNT	= 4,
+			BLOCK_SIZE	= 1024 * 1024
+		};
+		
+	protected:
+		std::vector <char>						m_data;
+		std::array <std::size_t, BLOCK_COUNT>	m_block_sizes{};
+		std::thread								m_thread;
+		std::mutex								m_mutex;
+		std::condition_variable					m_cv;
+		std::exception_ptr						m_exception{};
+		std::size_t								m_read_count{0};		// Number of blocks read, not counting the current one.
+		std::size_t								m_write_count{0};		// Number of blocks written.
+		int										m_fd{-1};
+		bool									m_has_current_block{false};
+		bool									m_producer_finished{false};
+		bool									m_should_stop{false};
+		
+	protected:
+		void produce();
+		void write_blocks(std::istream &stream);
+		int_type underflow() override;
+		
+	public:
+		decompressing_streambuf() = default;
+		decompressing_streambuf(decompressing_streambuf const &) = delete;
+		decompressing_streambuf &operator=(decompressing_streambuf const &) = delete;
+		~decompressing_streambuf() { close(); }
+		
+		// Start reading the file and take ownership of the descriptor.
+		void open(int const fd);
+		void close();
+	};
+	
+	
+	// An input stream for reading a file that may be compressed with gzip or
+	// bzip2. The compression is detected from the contents. Errors in
+	// decompression are thrown from the reading functions.
+	class decompressing_istream : public std::istream
+	{
+	protected:
+		decompressing_streambuf	m_buffer;
+		
+	public:
+		decompressing_istream():
+			std::istream(&m_buffer)
+		{
+			exceptions(std::ios_base::badbit);
+		}
+		
+		decompressing_istream(decompressing_istream const &) = delete;
+		decompressing_istream &operator=(decompressing_istream const &) = delete;
+		
+		void open(int const fd) { m_buffer.open(fd); }
+	};
+}
+
+#endif
@@ -21,7 +21,9 @@
 #include <cstdint>
 #include <cstdio>
 #include <dispatch/dispatch.h>
+#include <exception>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <stdexcept>
 
@@ -64,6 +66,49 @@ namespace tribble { namespace detail {
 			delete ctx;
 		}
 	};
+	
+	
+	template <typename Fn>
+	class dispatch_apply_fn_context
+	{
+	public:
+		typedef Fn function_type;
+		
+	protected:
+		function_type		&m_fn;
+		std::exception_ptr	m_exception{};
+		std::mutex			m_mutex{};
+		
+	public:
+		dispatch_apply_fn_context(Fn &fn):
+			m_fn(fn)
+		{
+		}
+		
+		static void call_fn(void *dispatch_context, std::size_t const i)
+		{
+			assert(dispatch_context);
+			auto *ctx(reinterpret_cast <dispatch_apply_fn_context *>(dispatch_context));
+			
+			// Exceptions may not be thrown through libdispatch, so store the first one.
+			try
+			{
+				ctx->m_fn(i);
+			}
+			catch (...)
+			{
+				std::lock_guard <std::mutex> lock_guard(ctx->m_mutex);
+				if (!ctx->m_exception)
+					ctx->m_exception = std::current_exception();
+			}
+		}
+		
+		void rethrow_if_needed() const
+		{
+			if (m_exception)
+				std::rethrow_exception(m_exception);
+		}
+	};
 }}
 
 
@@ -78,6 +123,14 @@ namespace tribble {
 		dispatch_async_f(queue, ctx, &context_type::call_fn);
 	}
 	
+	template <typename Fn>
+	void dispatch_group_async_fn(dispatch_group_t group, dispatch_queue_t queue, Fn fn)
+	{
+		typedef detail::dispatch_fn_context <Fn> context_type;
+		auto *ctx(new context_type(std::move(fn)));
+		dispatch_group_async_f(group, queue, ctx, &context_type::call_fn);
+	}
+	
 	template <typename Fn>
 	void dispatch_barrier_async_fn(dispatch_queue_t queue, Fn fn)
 	{
@@ -85,6 +138,17 @@ namespace tribble {
 		auto *ctx(new context_type(std::move(fn)));
 		dispatch_barrier_async_f(queue, ctx, &context_type::call_fn);
 	}
+	
+	// Call fn with 0, 1, …, iterations - 1, possibly in parallel, and wait for the calls to finish.
+	// Rethrow the first exception thrown by fn, if any.
+	template <typename Fn>
+	void dispatch_apply_fn(std::size_t const iterations, dispatch_queue_t queue, Fn fn)
+	{
+		typedef detail::dispatch_apply_fn_context <Fn> context_type;
+		context_type ctx(fn);
+		dispatch_apply_f(iterations, queue, &ctx, &context_type::call_fn);
+		ctx.rethrow_if_needed();
+	}
 }
 
 #endif
@@ -20,6 +20,7 @@
 #include <iostream>
 #include <iterator>
 #include <sdsl/int_vector.hpp>
+#include <tribble/line_block_reader.hh>
 #include <tribble/vector_source.hh>
 
 
@@ -52,9 +53,8 @@ namespace tribble {
 	public:
 		void read_from_stream(std::istream &stream, vector_source &vector_source, t_callback &cb) const
 		{
-			std::size_t const size(1024 * 1024);
 			std::size_t seq_length(0);
-			vector_type buffer(size, 0);
+			line_block_reader line_reader(stream);
 			std::unique_ptr <vector_type> seq;
 			std::string current_identifier;
 			
@@ -66,16 +66,14 @@ namespace tribble {
 				if (t_initial_size && seq->size() < t_initial_size)
 					seq->resize(t_initial_size);
 
-				// Get a char pointer to the data part of the buffer.
-				// This is safe because the element width is 8.
-				char *buffer_data(reinterpret_cast <char *>(buffer.data()));
-				
-				while (stream.getline(buffer_data, size - 1, '\n'))
+				char const *line(nullptr);
+				std::size_t count(0);
+				while (line_reader.read_line(line, count))
 				{
 					++i;
 					
 					// Discard comments.
-					auto const first(buffer_data[0]);
+					auto const first(count ? line[0] : '\0');
 					if (';' == first)
 						continue;
 					
@@ -94,14 +92,10 @@ namespace tribble {
 								seq->resize(t_initial_size);
 						}
 						
-						current_identifier = std::string(1 + buffer_data);
+						current_identifier.assign(1 + line, count - 1);
 						continue;
 					}
 					
-					// Get the number of characters extracted by the last input operation.
-					// Delimiter is counted in gcount.
-					std::streamsize const count(stream.gcount() - 1);
-					
 					while (true)
 					{
 						auto const capacity(seq->size());
@@ -115,15 +109,15 @@ namespace tribble {
 							// std::vector may reserve more than 2 * capacity (using reserve),
 							// sdsl::int_vector reserves the exact amount.
 							// Make sure that at least some space is reserved.
-							auto new_size(capacity);
+							auto new_size(2 * capacity);
 							if (new_size < 64)
 								new_size = 64;
 							seq->resize(new_size);
 						}
 					}
 
-					auto const it(buffer.begin());
-					std::copy(it, it + count, seq->begin() + seq_length);
+					// This is safe because the element width is 8.
+					std::copy_n(line, count, reinterpret_cast <char *>(seq->data()) + seq_length);
 					seq_length += count;
 				}
 				
@@ -0,0 +1,188 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_FASTQ_READER_HH
+#define TRIBBLE_FASTQ_READER_HH
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <sdsl/int_vector.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <tribble/fasta_reader.hh>
+#include <tribble/find_character.hh>
+#include <tribble/line_block_reader.hh>
+#include <tribble/vector_source.hh>
+
+
+namespace tribble { namespace detail {
+	
+	// Parse the lines of a FASTQ record. The record consists of the identifier
+	// line that begins with '@', the sequence, the separator line that
+	// begins with '+' and the quality values, which are not used.
+	// Empty lines between the records are skipped.
+	class fastq_record_parser
+	{
+	protected:
+		std::size_t m_lineno{0};
+		std::size_t m_record_line{0};
+		
+	protected:
+		void handle_unexpected_line(char const *expected) const
+		{
+			std::stringstream output;
+			output << "Expected " << expected << " on line " << m_lineno << " of the FASTQ input.";
+			throw std::runtime_error(output.str());
+		}
+		
+	public:
+		// Returns true if the line is the sequence of a record.
+		bool handle_line(char const *line, std::size_t const length)
+		{
+			++m_lineno;
+			switch (m_record_line)
+			{
+				case 0:
+					if (0 == length)
+						return false;
+					if ('@' != line[0])
+						handle_unexpected_line("a line that begins with '@'");
+					m_record_line = 1;
+					return false;
+					
+				case 1:
+					m_record_line = 2;
+					return true;
+					
+				case 2:
+					if (! (length && '+' == line[0]))
+						handle_unexpected_line("a line that begins with '+'");
+					m_record_line = 3;
+					return false;
+					
+				case 3:
+					m_record_line = 0;
+					return false;
+					
+				default:
+					assert(0);
+					return false;
+			}
+		}
+		
+		bool is_at_identifier() const { return 1 == m_record_line; }
+		
+		void finish() const
+		{
+			if (m_record_line)
+				throw std::runtime_error("The FASTQ input ends in the middle of a record.");
+		}
+	};
+}}
+
+
+namespace tribble {
+	
+	// Read four-line FASTQ records and pass the sequences to the callback.
+	// The callback interface is the same as that of fasta_reader.
+	template <typename t_callback = detail::fasta_reader_cb, size_t t_initial_size = 128>
+	class fastq_reader
+	{
+	protected:
+		typedef vector_source::vector_type vector_type;
+		
+	public:
+		void read_from_stream(std::istream &stream, vector_source &vector_source, t_callback &cb) const
+		{
+			line_block_reader line_reader(stream);
+			detail::fastq_record_parser parser;
+			std::string current_identifier;
+			
+			char const *line(nullptr);
+			std::size_t count(0);
+			while (line_reader.read_line(line, count))
+			{
+				if (!parser.handle_line(line, count))
+				{
+					if (parser.is_at_identifier())
+						current_identifier.assign(1 + line, count - 1);
+					continue;
+				}
+				
+				if (0 == count)
+					continue;
+				
+				std::unique_ptr <vector_type> seq;
+				vector_source.get_vector(seq);
+				
+				auto capacity(seq->size());
+				if (capacity < count)
+				{
+					capacity = std::max(capacity, std::size_t(t_initial_size));
+					while (capacity < count)
+					{
+						if (2 * capacity < capacity)
+							throw std::runtime_error("Can't reserve more space.");
+						capacity *= 2;
+					}
+					seq->resize(capacity);
+				}
+				
+				// This is safe because the element width is 8.
+				std::copy_n(line, count, reinterpret_cast <char *>(seq->data()));
+				cb.handle_sequence(current_identifier, seq, count, vector_source);
+				assert(nullptr == seq.get());
+			}
+			
+			parser.finish();
+			cb.finish();
+		}
+		
+		// Read the records from a buffer, e.g. a mapped file, and pass the
+		// sequences to the callback as pointers to the buffer without copying.
+		void read_from_buffer(char const *data, std::size_t const size, t_callback &cb) const
+		{
+			detail::fastq_record_parser parser;
+			std::string current_identifier;
+			
+			auto const *line(data);
+			auto const *end(data + size);
+			while (line != end)
+			{
+				auto const *line_end(find_character(line, end, '\n'));
+				std::size_t const count(line_end - line);
+				
+				if (parser.handle_line(line, count))
+				{
+					if (count)
+						cb.handle_sequence(current_identifier, reinterpret_cast <std::uint8_t const *>(line), count);
+				}
+				else if (parser.is_at_identifier())
+				{
+					current_identifier.assign(1 + line, count - 1);
+				}
+				
+				line = (line_end == end ? end : 1 + line_end);
+			}
+			
+			parser.finish();
+			cb.finish();
+		}
+	};
+}
+
+#endif
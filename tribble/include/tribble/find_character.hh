@@ -0,0 +1,52 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_FIND_CHARACTER_HH
+#define TRIBBLE_FIND_CHARACTER_HH
+
+#include <cstring>
+
+
+namespace tribble {
+	
+	// Find the first occurrence of c in [begin, end) and return end if there
+	// is none. memchr is vectorised in the common C libraries and selects
+	// the instruction set at run time, which was faster in practice than
+	// comparing SSE2 or AVX2 registers here.
+	inline char const *find_character(char const *begin, char const *end, char const c)
+	{
+		auto const *pos(static_cast <char const *>(std::memchr(begin, c, end - begin)));
+		return pos ? pos : end;
+	}
+	
+	
+	// Find the next line that begins with c, e.g. the next FASTA record,
+	// starting from pos and return end if there is none. The character is
+	// searched for first since it is expected to be rarer than newlines.
+	inline char const *find_line_beginning_with(char const *begin, char const *pos, char const *end, char const c)
+	{
+		while (pos != end)
+		{
+			pos = find_character(pos, end, c);
+			if (pos == end || pos == begin || '\n' == pos[-1])
+				return pos;
+			++pos;
+		}
+		return end;
+	}
+}
+
+#endif
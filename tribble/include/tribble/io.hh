@@ -19,6 +19,8 @@
 
 #include <boost/iostreams/device/file_descriptor.hpp>
 #include <boost/iostreams/stream.hpp>
+#include <tribble/decompressing_istream.hh>
+#include <tribble/mapped_file.hh>
 
 
 namespace tribble {
@@ -31,7 +33,13 @@ namespace tribble {
 	> file_ostream;
 
 	void open_file_for_reading(char const *fname, file_istream &stream);
+	void open_file_for_reading(char const *fname, mapped_file_istream &stream);
+	void open_file_for_reading(char const *fname, mapped_file &file);
+	void open_file_for_reading(char const *fname, decompressing_istream &stream);
 	void open_file_for_writing(char const *fname, file_ostream &stream);
+	
+	// Check whether the file may be mapped, i.e. it is not e.g. a pipe.
+	bool is_regular_file(char const *fname);
 }
 
 #endif
\ No newline at end of file
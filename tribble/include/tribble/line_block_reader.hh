@@ -0,0 +1,114 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_LINE_BLOCK_READER_HH
+#define TRIBBLE_LINE_BLOCK_READER_HH
+
+#include <algorithm>
+#include <cassert>
+#include <istream>
+#include <stdexcept>
+#include <tribble/find_character.hh>
+#include <vector>
+
+
+namespace tribble {
+	
+	// Read a stream in large blocks and split them into lines. The lines
+	// are returned as pointers to the buffer without the newline, so they
+	// are valid only until the next call to read_line(). If a line does not
+	// fit into the buffer, its size is doubled, so lines of any length are
+	// read in amortised linear time.
+	class line_block_reader
+	{
+	protected:
+		std::istream		*m_stream{nullptr};
+		std::vector <char>	m_buffer;
+		std::size_t			m_begin{0};		// Beginning of the unread part of the buffer.
+		std::size_t			m_scanned{0};	// End of the part known not to contain a newline.
+		std::size_t			m_end{0};		// End of the filled part of the buffer.
+		bool				m_eof{false};
+		
+	protected:
+		// Move the unread characters to the beginning of the buffer and fill the rest.
+		void fill_buffer()
+		{
+			if (m_begin)
+			{
+				std::copy(m_buffer.begin() + m_begin, m_buffer.begin() + m_end, m_buffer.begin());
+				m_end -= m_begin;
+				m_scanned -= m_begin;
+				m_begin = 0;
+			}
+			
+			if (m_end == m_buffer.size())
+			{
+				auto const size(m_buffer.size());
+				if (2 * size < size)
+					throw std::runtime_error("Can't reserve more space.");
+				m_buffer.resize(2 * size);
+			}
+			
+			m_stream->read(m_buffer.data() + m_end, m_buffer.size() - m_end);
+			auto const count(m_stream->gcount());
+			m_end += count;
+			if (0 == count)
+				m_eof = true;
+		}
+		
+	public:
+		line_block_reader(std::istream &stream, std::size_t const block_size = 1024 * 1024):
+			m_stream(&stream),
+			m_buffer(block_size, 0)
+		{
+			assert(block_size);
+		}
+		
+		bool read_line(char const *&line, std::size_t &length)
+		{
+			while (true)
+			{
+				auto const *data(m_buffer.data());
+				auto const *nl(find_character(data + m_scanned, data + m_end, '\n'));
+				if (nl != data + m_end)
+				{
+					line = data + m_begin;
+					length = nl - line;
+					m_begin = 1 + nl - data;
+					m_scanned = m_begin;
+					return true;
+				}
+				
+				m_scanned = m_end;
+				if (m_eof)
+				{
+					// Handle the last line if it does not end with a newline.
+					if (m_begin == m_end)
+						return false;
+					
+					line = data + m_begin;
+					length = m_end - m_begin;
+					m_begin = m_end;
+					return true;
+				}
+				
+				fill_buffer();
+			}
+		}
+	};
+}
+
+#endif
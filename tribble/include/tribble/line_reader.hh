@@ -21,6 +21,8 @@
 #include <iostream>
 #include <iterator>
 #include <sdsl/int_vector.hpp>
+#include <tribble/find_character.hh>
+#include <tribble/line_block_reader.hh>
 #include <tribble/vector_source.hh>
 
 
@@ -53,18 +55,15 @@ namespace tribble {
 	public:
 		void read_from_stream(std::istream &stream, vector_source &vector_source, t_callback &cb) const
 		{
-			std::size_t const size(1024 * 1024);
-			vector_type buffer(size, 0);
+			line_block_reader line_reader(stream);
 			std::unique_ptr <vector_type> seq;
 			uint32_t line_no(0);
 			
 			try
 			{
-				// Get a char pointer to the data part of the buffer.
-				// This is safe because the element width is 8.
-				char *buffer_data(reinterpret_cast <char *>(buffer.data()));
-
-				while (stream.getline(buffer_data, size - 1, '\n'))
+				char const *line(nullptr);
+				std::size_t count(0);
+				while (line_reader.read_line(line, count))
 				{
 					++line_no;
 					
@@ -76,10 +75,6 @@ namespace tribble {
 							seq->resize(t_initial_size);
 					}
 
-					// Get the number of characters extracted by the last input operation.
-					// Delimiter is counted in gcount.
-					std::streamsize const count(stream.gcount() - 1);
-					
 					while (true)
 					{
 						auto capacity(seq->size());
@@ -100,8 +95,8 @@ namespace tribble {
 						}
 					}
 					
-					auto const it(buffer.begin());
-					std::copy_n(it, count, seq->begin());
+					// This is safe because the element width is 8.
+					std::copy_n(line, count, reinterpret_cast <char *>(seq->data()));
 					
 					// If there was data, handle it.
 					if (count)
@@ -119,6 +114,30 @@ namespace tribble {
 			
 			cb.finish();
 		}
+		
+		// Read the lines from a buffer, e.g. a mapped file, and pass them to
+		// the callback as pointers to the buffer without copying.
+		void read_from_buffer(char const *data, std::size_t const size, t_callback &cb) const
+		{
+			uint32_t line_no(0);
+			auto const *line(data);
+			auto const *end(data + size);
+			while (line != end)
+			{
+				++line_no;
+				
+				auto const *line_end(find_character(line, end, '\n'));
+				std::size_t const count(line_end - line);
+				
+				// If there was data, handle it.
+				if (count)
+					cb.handle_sequence(line_no, reinterpret_cast <std::uint8_t const *>(line), count);
+				
+				line = (line_end == end ? end : 1 + line_end);
+			}
+			
+			cb.finish();
+		}
 	};
 }
 
@@ -0,0 +1,198 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_MAPPABLE_VECTOR_HH
+#define TRIBBLE_MAPPABLE_VECTOR_HH
+
+#include <cassert>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <sdsl/io.hpp>
+#include <sdsl/structure_tree.hpp>
+#include <sdsl/util.hpp>
+#include <stdexcept>
+#include <string>
+#include <tribble/mapped_file.hh>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace tribble {
+	
+	// An array of trivially copyable values that is serialized page-aligned.
+	// When loaded from a memory_streambuf, e.g. a mapped index file, the
+	// values are not copied but referred to in the buffer, which has to
+	// outlive the vector. Such a vector is read-only.
+	template <typename t_value>
+	class mappable_vector
+	{
+		static_assert(std::is_trivially_copyable <t_value>::value, "Expected a trivially copyable type.");
+		
+	public:
+		typedef t_value						value_type;
+		typedef std::size_t					size_type;
+		
+		enum : std::size_t { ALIGNMENT = 4096 };
+		
+	protected:
+		std::vector <value_type>	m_owned;
+		value_type const			*m_data{nullptr};
+		size_type					m_size{0};
+		
+	public:
+		mappable_vector() = default;
+		
+		mappable_vector(size_type const size, value_type const value):
+			m_owned(size, value),
+			m_data(m_owned.data()),
+			m_size(size)
+		{
+		}
+		
+		mappable_vector(mappable_vector const &other):
+			m_owned(other.m_data, other.m_data + other.m_size),
+			m_data(m_owned.data()),
+			m_size(other.m_size)
+		{
+		}
+		
+		mappable_vector(mappable_vector &&other)
+		{
+			swap(other);
+		}
+		
+		mappable_vector &operator=(mappable_vector const &other)
+		{
+			if (this != &other)
+			{
+				mappable_vector tmp(other);
+				swap(tmp);
+			}
+			return *this;
+		}
+		
+		mappable_vector &operator=(mappable_vector &&other)
+		{
+			swap(other);
+			return *this;
+		}
+		
+		// Swapping the vectors does not invalidate pointers to their contents.
+		void swap(mappable_vector &other)
+		{
+			m_owned.swap(other.m_owned);
+			std::swap(m_data, other.m_data);
+			std::swap(m_size, other.m_size);
+		}
+		
+		size_type size() const { return m_size; }
+		bool empty() const { return 0 == m_size; }
+		bool is_mapped() const { return m_size && m_owned.empty(); }
+		
+		value_type const *data() const { return m_data; }
+		value_type const &operator[](size_type const i) const { return m_data[i]; }
+		
+		value_type *data() { assert(!is_mapped()); return m_owned.data(); }
+		value_type &operator[](size_type const i) { assert(!is_mapped()); return m_owned[i]; }
+		
+		size_type serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name = "") const;
+		void load(std::istream &in);
+	};
+	
+	
+	template <typename t_value>
+	auto mappable_vector <t_value>::serialize(
+		std::ostream &out,
+		sdsl::structure_tree_node *v,
+		std::string name
+	) const -> size_type
+	{
+		sdsl::structure_tree_node *child(sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this)));
+		size_type written_bytes(0);
+		
+		// Determine the padding needed for aligning the values. The stream
+		// position is not available when measuring the size.
+		std::uint64_t const size(m_size);
+		std::uint64_t padding(0);
+		{
+			auto const pos(out.tellp());
+			if (-1 != pos)
+			{
+				auto const values_pos(2 * sizeof(std::uint64_t) + std::size_t(pos));
+				padding = (ALIGNMENT - values_pos % ALIGNMENT) % ALIGNMENT;
+			}
+		}
+		
+		written_bytes += sdsl::write_member(size, out, child, "size");
+		written_bytes += sdsl::write_member(padding, out, child, "padding");
+		
+		for (std::uint64_t i(0); i < padding; ++i)
+			out.put(0);
+		written_bytes += padding;
+		
+		{
+			auto const byte_count(m_size * sizeof(value_type));
+			out.write(reinterpret_cast <char const *>(m_data), byte_count);
+			written_bytes += byte_count;
+		}
+		
+		sdsl::structure_tree::add_size(child, written_bytes);
+		return written_bytes;
+	}
+	
+	
+	template <typename t_value>
+	void mappable_vector <t_value>::load(std::istream &in)
+	{
+		std::uint64_t size(0);
+		std::uint64_t padding(0);
+		sdsl::read_member(size, in);
+		sdsl::read_member(padding, in);
+		
+		std::vector <value_type> owned;
+		m_owned.swap(owned);
+		m_size = size;
+		
+		// Refer to the buffer if it is in memory and the values are suitably aligned.
+		auto const byte_count(size * sizeof(value_type));
+		auto *buffer(dynamic_cast <memory_streambuf *>(in.rdbuf()));
+		if (buffer && padding + byte_count <= buffer->available())
+		{
+			auto const *values(buffer->current() + padding);
+			if (0 == reinterpret_cast <std::uintptr_t>(values) % alignof(value_type))
+			{
+				buffer->skip(padding + byte_count);
+				m_data = reinterpret_cast <value_type const *>(values);
+				
+				// The values are not read ahead, since rank queries access them at random.
+				advise_random(values, byte_count);
+				return;
+			}
+		}
+		
+		in.ignore(padding);
+		m_owned.resize(size);
+		in.read(reinterpret_cast <char *>(m_owned.data()), byte_count);
+		m_data = m_owned.data();
+		
+		if (!in)
+			throw std::runtime_error("Unable to read the vector contents.");
+	}
+}
+
+#endif
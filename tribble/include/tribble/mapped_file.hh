@@ -0,0 +1,102 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_MAPPED_FILE_HH
+#define TRIBBLE_MAPPED_FILE_HH
+
+#include <cstddef>
+#include <istream>
+#include <streambuf>
+
+
+namespace tribble {
+	
+	// A read-only memory mapping of a whole file. The pages are shared
+	// with other processes that map the same file.
+	class mapped_file
+	{
+	protected:
+		char const	*m_data{nullptr};
+		std::size_t	m_size{0};
+		
+	public:
+		mapped_file() = default;
+		mapped_file(mapped_file const &) = delete;
+		mapped_file &operator=(mapped_file const &) = delete;
+		
+		~mapped_file() { close(); }
+		
+		// Map the file and close the descriptor.
+		void open(int const fd);
+		void close();
+		
+		// Hint that the mapping will be read from the beginning to the end.
+		void advise_sequential() const;
+		
+		bool is_open() const { return nullptr != m_data; }
+		char const *data() const { return m_data; }
+		std::size_t size() const { return m_size; }
+	};
+	
+	
+	// Hint that the given part of a mapping will be accessed in random order,
+	// so that reading ahead of the accessed pages is not useful.
+	void advise_random(char const *data, std::size_t const size);
+	
+	
+	// A stream buffer for reading from memory that has been mapped or
+	// otherwise outlives the buffer. Structures that recognize the buffer
+	// may refer to its contents instead of copying them.
+	class memory_streambuf : public std::streambuf
+	{
+	public:
+		memory_streambuf() = default;
+		memory_streambuf(char const *data, std::size_t const size) { set_buffer(data, size); }
+		
+		void set_buffer(char const *data, std::size_t const size);
+		
+		// The unread part of the buffer.
+		char const *current() const { return gptr(); }
+		std::size_t available() const { return egptr() - gptr(); }
+		void skip(std::size_t const count);
+		
+	protected:
+		pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+		pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+	};
+	
+	
+	// An input stream for reading a mapped file.
+	class mapped_file_istream : public std::istream
+	{
+	protected:
+		mapped_file			m_file;
+		memory_streambuf	m_buffer;
+		
+	public:
+		mapped_file_istream():
+			std::istream(&m_buffer)
+		{
+		}
+		
+		mapped_file_istream(mapped_file_istream const &) = delete;
+		mapped_file_istream &operator=(mapped_file_istream const &) = delete;
+		
+		void open(int const fd);
+	};
+}
+
+#endif
@@ -0,0 +1,204 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_PARALLEL_FASTA_READER_HH
+#define TRIBBLE_PARALLEL_FASTA_READER_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <dispatch/dispatch.h>
+#include <string>
+#include <tribble/dispatch_fn.hh>
+#include <tribble/find_character.hh>
+#include <utility>
+#include <vector>
+
+
+namespace tribble { namespace detail {
+	
+	// The sequences of the records that begin in one chunk of the input.
+	// Sequences that consist of one line refer to the input, the others
+	// are concatenated in a buffer.
+	class fasta_chunk
+	{
+	public:
+		typedef std::pair <char const *, std::size_t> identifier_type;
+		
+	protected:
+		struct sequence_entry
+		{
+			char const		*data{nullptr};	// nullptr if the sequence is in the buffer.
+			std::uint64_t	offset{0};
+			std::uint64_t	length{0};
+			identifier_type	identifier;
+			
+			sequence_entry(char const *data_, std::uint64_t const offset_, std::uint64_t const length_, identifier_type const &identifier_):
+				data(data_),
+				offset(offset_),
+				length(length_),
+				identifier(identifier_)
+			{
+			}
+		};
+		
+	protected:
+		std::vector <std::uint8_t>		m_sequence_data;
+		std::vector <sequence_entry>	m_sequences;
+		
+	public:
+		inline std::size_t size() const { return m_sequences.size(); }
+		
+		inline std::uint8_t const *sequence(std::size_t const idx) const
+		{
+			auto const &entry(m_sequences[idx]);
+			if (entry.data)
+				return reinterpret_cast <std::uint8_t const *>(entry.data);
+			return m_sequence_data.data() + entry.offset;
+		}
+		
+		inline std::size_t sequence_length(std::size_t const idx) const { return m_sequences[idx].length; }
+		inline identifier_type const &identifier(std::size_t const idx) const { return m_sequences[idx].identifier; }
+		
+		// Parse the lines in [begin, end) the same way as fasta_reader.
+		// Comment lines are skipped and records without sequence are discarded.
+		void parse(char const *begin, char const *end)
+		{
+			m_sequence_data.clear();
+			m_sequences.clear();
+			
+			identifier_type current_identifier(begin, 0);
+			char const *first_line(nullptr);
+			std::size_t line_count(0);
+			std::size_t offset(0);
+			std::size_t seq_length(0);
+			
+			auto const add_sequence([&](){
+				if (line_count)
+				{
+					m_sequences.emplace_back((1 == line_count ? first_line : nullptr), offset, seq_length, current_identifier);
+					line_count = 0;
+					seq_length = 0;
+				}
+			});
+			
+			auto const *line(begin);
+			while (line != end)
+			{
+				auto const *line_end(find_character(line, end, '\n'));
+				auto const count(line_end - line);
+				
+				// Empty lines do not affect the sequence.
+				if (count)
+				{
+					auto const first(*line);
+					if ('>' == first)
+					{
+						add_sequence();
+						current_identifier = identifier_type(1 + line, count - 1);
+					}
+					else if (';' != first)
+					{
+						// Copy the sequence to the buffer only if it has more than one line.
+						if (0 == line_count)
+							first_line = line;
+						else
+						{
+							if (1 == line_count)
+							{
+								offset = m_sequence_data.size();
+								m_sequence_data.insert(m_sequence_data.end(), first_line, first_line + seq_length);
+							}
+							m_sequence_data.insert(m_sequence_data.end(), line, line_end);
+						}
+						
+						seq_length += count;
+						++line_count;
+					}
+				}
+				
+				line = (line_end == end ? end : 1 + line_end);
+			}
+			
+			add_sequence();
+		}
+	};
+}}
+
+
+namespace tribble {
+	
+	// Read FASTA from a buffer, e.g. a mapped file, by splitting it into
+	// chunks at record boundaries and parsing the chunks in parallel. The
+	// sequences are passed to the callback in the order of the input on the
+	// calling thread. Single-line sequences are passed as pointers to the
+	// buffer, so the callback should copy the sequence if it needs to retain it.
+	template <typename t_callback>
+	class parallel_fasta_reader
+	{
+	protected:
+		std::size_t m_chunk_size{16 * 1024 * 1024};
+		std::size_t m_thread_count{1};
+		
+	public:
+		parallel_fasta_reader(std::size_t const thread_count):
+			m_thread_count(std::max(std::size_t(1), thread_count))
+		{
+		}
+		
+		void read_from_buffer(char const *data, std::size_t const size, t_callback &cb) const
+		{
+			dispatch_queue_t queue(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+			
+			// Parse one chunk per thread at a time to limit the memory use.
+			std::vector <detail::fasta_chunk> chunks(m_thread_count);
+			std::vector <std::pair <char const *, char const *>> ranges;
+			ranges.reserve(m_thread_count);
+			
+			auto const *pos(data);
+			auto const *end(data + size);
+			while (pos != end)
+			{
+				ranges.clear();
+				while (pos != end && ranges.size() < m_thread_count)
+				{
+					auto const *chunk_end(find_line_beginning_with(data, pos + std::min(m_chunk_size, std::size_t(end - pos)), end, '>'));
+					ranges.emplace_back(pos, chunk_end);
+					pos = chunk_end;
+				}
+				
+				dispatch_apply_fn(ranges.size(), queue, [&chunks, &ranges](std::size_t const i) {
+					chunks[i].parse(ranges[i].first, ranges[i].second);
+				});
+				
+				std::string identifier;
+				for (std::size_t i(0), count(ranges.size()); i < count; ++i)
+				{
+					auto const &chunk(chunks[i]);
+					for (std::size_t j(0), seq_count(chunk.size()); j < seq_count; ++j)
+					{
+						auto const &chunk_identifier(chunk.identifier(j));
+						identifier.assign(chunk_identifier.first, chunk_identifier.second);
+						cb.handle_sequence(identifier, chunk.sequence(j), chunk.sequence_length(j));
+					}
+				}
+			}
+			
+			cb.finish();
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,608 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#ifndef TRIBBLE_SMALL_ALPHABET_WT_HH
+#define TRIBBLE_SMALL_ALPHABET_WT_HH
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <sdsl/int_vector.hpp>
+#include <sdsl/int_vector_buffer.hpp>
+#include <sdsl/iterators.hpp>
+#include <sdsl/wt_algorithm.hpp>
+#include <sdsl/wt_hutu.hpp>
+#include <tribble/mappable_vector.hh>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+
+namespace tribble {
+	
+	// A wavelet tree replacement for byte alphabets that stores the text
+	// without a tree if it has at most eight distinct symbols. In that case
+	// the symbols are replaced with three-bit codes in lexicographic order
+	// and stored in bit planes. Each block of 256 symbols has the three
+	// planes interleaved with the symbol counts preceding the block in its
+	// superblock, so rank takes one block and a few popcounts.
+	// Texts with larger alphabets are stored in the fallback wavelet tree.
+	// The blocks are page-aligned in the serialized form and may be used
+	// directly from a mapped index file.
+	template <typename t_fallback = sdsl::wt_hutu <>>
+	class small_alphabet_wt
+	{
+	public:
+		typedef sdsl::int_vector <>::size_type					size_type;
+		typedef typename t_fallback::value_type					value_type;
+		typedef typename t_fallback::difference_type			difference_type;
+		typedef sdsl::random_access_const_iterator <small_alphabet_wt>	const_iterator;
+		typedef const_iterator									iterator;
+		typedef sdsl::wt_tag									index_category;
+		typedef sdsl::byte_alphabet_tag							alphabet_category;
+		typedef t_fallback										fallback_type;
+		
+		enum { lex_ordered = t_fallback::lex_ordered };
+		
+		enum : std::uint8_t { MAX_SIGMA = 8 };
+		
+	protected:
+		typedef std::array <size_type, MAX_SIGMA>				count_array;
+		
+		enum : std::size_t {
+			PLANE_COUNT			= 3,
+			BLOCK_SIZE			= 256,
+			WORDS_PER_PLANE		= BLOCK_SIZE / 64,
+			COUNT_WORDS			= MAX_SIGMA / 4,	// 16-bit counts.
+			BLOCK_WORDS			= COUNT_WORDS + PLANE_COUNT * WORDS_PER_PLANE,
+			SUPERBLOCK_SIZE		= 65536
+		};
+		
+		static_assert(1 << PLANE_COUNT == std::size_t(MAX_SIGMA), "Unexpected number of bit planes.");
+		
+	protected:
+		mappable_vector <std::uint64_t>	m_blocks;
+		mappable_vector <std::uint64_t>	m_superblocks;		// MAX_SIGMA counts per superblock.
+		sdsl::int_vector <8>			m_symbols;			// Symbols by code.
+		sdsl::int_vector <8>			m_codes;			// Codes by symbol, MAX_SIGMA if not present.
+		fallback_type					m_fallback;
+		size_type						m_size{0};
+		size_type						m_sigma{0};
+		bool							m_is_flat{false};
+		
+	public:
+		size_type const					&sigma{m_sigma};
+		
+	protected:
+		inline std::uint64_t const *block_ptr(size_type const block_idx) const
+		{
+			return m_blocks.data() + block_idx * BLOCK_WORDS;
+		}
+		
+		static inline size_type block_count(std::uint64_t const *block, std::uint8_t const code)
+		{
+			return (block[code / 4] >> (16 * (code % 4))) & 0xffff;
+		}
+		
+		// Mark the positions of the given code in one word of each plane.
+		static inline std::uint64_t match_mask(std::uint64_t const *block, std::size_t const word_idx, std::uint8_t const code)
+		{
+			auto const *planes(block + COUNT_WORDS);
+			std::uint64_t retval(~std::uint64_t(0));
+			for (std::size_t i(0); i < PLANE_COUNT; ++i)
+			{
+				auto const word(planes[i * WORDS_PER_PLANE + word_idx]);
+				retval &= ((code >> i) & 0x1 ? word : ~word);
+			}
+			return retval;
+		}
+		
+		static inline size_type rank_in_block(std::uint64_t const *block, size_type const offset, std::uint8_t const code)
+		{
+			assert(offset < BLOCK_SIZE);
+			size_type retval(0);
+			auto const word_count(offset / 64);
+			for (std::size_t i(0); i < word_count; ++i)
+				retval += sdsl::bits::cnt(match_mask(block, i, code));
+			
+			auto const bit_count(offset % 64);
+			if (bit_count)
+				retval += sdsl::bits::cnt(match_mask(block, word_count, code) & sdsl::bits::lo_set[bit_count]);
+			
+			return retval;
+		}
+		
+		// Add the number of occurrences of each code in [begin, end) of the block
+		// to counts. The masks of all codes are derived from the planes at once.
+		static inline void add_code_counts(std::uint64_t const *block, size_type const begin, size_type const end, count_array &counts)
+		{
+			static_assert(3 == PLANE_COUNT, "Unexpected number of bit planes.");
+			assert(begin <= end);
+			assert(end <= BLOCK_SIZE);
+			
+			auto const *planes(block + COUNT_WORDS);
+			auto const first_word(begin / 64);
+			auto const last_word((end + 63) / 64);
+			for (std::size_t word_idx(first_word); word_idx < last_word; ++word_idx)
+			{
+				std::uint64_t mask(~std::uint64_t(0));
+				if (word_idx == first_word)
+					mask &= ~sdsl::bits::lo_set[begin % 64];
+				if (word_idx == end / 64)
+					mask &= sdsl::bits::lo_set[end % 64];
+				
+				auto const p0(planes[word_idx]);
+				auto const p1(planes[WORDS_PER_PLANE + word_idx]);
+				auto const p2(planes[2 * WORDS_PER_PLANE + word_idx]);
+				std::uint64_t const high[4]{
+					mask & ~p2 & ~p1,
+					mask & ~p2 & p1,
+					mask & p2 & ~p1,
+					mask & p2 & p1
+				};
+				
+				for (std::size_t k(0); k < 4; ++k)
+				{
+					counts[2 * k] += sdsl::bits::cnt(high[k] & ~p0);
+					counts[2 * k + 1] += sdsl::bits::cnt(high[k] & p0);
+				}
+			}
+		}
+		
+		inline std::uint8_t code_at(size_type const i) const
+		{
+			assert(i < m_size);
+			auto const *planes(block_ptr(i / BLOCK_SIZE) + COUNT_WORDS);
+			auto const offset(i % BLOCK_SIZE);
+			auto const word_idx(offset / 64);
+			auto const bit_idx(offset % 64);
+			std::uint8_t retval(0);
+			for (std::size_t j(0); j < PLANE_COUNT; ++j)
+				retval |= ((planes[j * WORDS_PER_PLANE + word_idx] >> bit_idx) & 0x1) << j;
+			return retval;
+		}
+		
+		inline size_type rank_code(size_type const i, std::uint8_t const code) const
+		{
+			assert(i <= m_size);
+			auto const *block(block_ptr(i / BLOCK_SIZE));
+			return (
+				m_superblocks[(i / SUPERBLOCK_SIZE) * MAX_SIGMA + code] +
+				block_count(block, code) +
+				rank_in_block(block, i % BLOCK_SIZE, code)
+			);
+		}
+		
+		// Rank of each code in [0, i).
+		inline void rank_codes(size_type const i, count_array &ranks) const
+		{
+			assert(i <= m_size);
+			auto const *block(block_ptr(i / BLOCK_SIZE));
+			auto const *superblock(m_superblocks.data() + (i / SUPERBLOCK_SIZE) * MAX_SIGMA);
+			for (std::uint8_t code(0); code < MAX_SIGMA; ++code)
+				ranks[code] = superblock[code] + block_count(block, code);
+			
+			add_code_counts(block, 0, i % BLOCK_SIZE, ranks);
+		}
+		
+		// Rank of each code in [0, i) and [0, j). If both are in the same
+		// block, only the symbols between them are counted for the latter.
+		inline void rank_codes(size_type const i, size_type const j, count_array &ranks_i, count_array &ranks_j) const
+		{
+			assert(i <= j);
+			rank_codes(i, ranks_i);
+			
+			auto const block_idx(i / BLOCK_SIZE);
+			if (block_idx == j / BLOCK_SIZE)
+			{
+				ranks_j = ranks_i;
+				add_code_counts(block_ptr(block_idx), i % BLOCK_SIZE, j % BLOCK_SIZE, ranks_j);
+			}
+			else
+			{
+				rank_codes(j, ranks_j);
+			}
+		}
+		
+		void construct_flat(sdsl::int_vector_buffer <8> &buf, size_type const size);
+		
+	public:
+		small_alphabet_wt() = default;
+		
+		small_alphabet_wt(sdsl::int_vector_buffer <8> &buf, size_type const size);
+		
+		small_alphabet_wt(small_alphabet_wt const &other):
+			m_blocks(other.m_blocks),
+			m_superblocks(other.m_superblocks),
+			m_symbols(other.m_symbols),
+			m_codes(other.m_codes),
+			m_fallback(other.m_fallback),
+			m_size(other.m_size),
+			m_sigma(other.m_sigma),
+			m_is_flat(other.m_is_flat)
+		{
+		}
+		
+		small_alphabet_wt(small_alphabet_wt &&other)
+		{
+			swap(other);
+		}
+		
+		small_alphabet_wt &operator=(small_alphabet_wt const &other)
+		{
+			if (this != &other)
+			{
+				small_alphabet_wt tmp(other);
+				swap(tmp);
+			}
+			return *this;
+		}
+		
+		small_alphabet_wt &operator=(small_alphabet_wt &&other)
+		{
+			swap(other);
+			return *this;
+		}
+		
+		void swap(small_alphabet_wt &other);
+		
+		bool is_flat() const { return m_is_flat; }
+		size_type size() const { return m_size; }
+		bool empty() const { return 0 == m_size; }
+		
+		const_iterator begin() const { return const_iterator(this, 0); }
+		const_iterator end() const { return const_iterator(this, m_size); }
+		
+		value_type operator[](size_type const i) const
+		{
+			if (!m_is_flat)
+				return m_fallback[i];
+			
+			return m_symbols[code_at(i)];
+		}
+		
+		size_type rank(size_type const i, value_type const c) const
+		{
+			if (!m_is_flat)
+				return m_fallback.rank(i, c);
+			
+			auto const code(m_codes[c]);
+			if (MAX_SIGMA == code)
+				return 0;
+			
+			return rank_code(i, code);
+		}
+		
+		std::pair <size_type, value_type> inverse_select(size_type const i) const
+		{
+			if (!m_is_flat)
+				return m_fallback.inverse_select(i);
+			
+			auto const code(code_at(i));
+			return std::make_pair(rank_code(i, code), value_type(m_symbols[code]));
+		}
+		
+		size_type select(size_type const i, value_type const c) const;
+		
+		template <typename t_cs, typename t_rank>
+		void interval_symbols(
+			size_type const i,
+			size_type const j,
+			size_type &k,
+			t_cs &cs,
+			t_rank &rank_c_i,
+			t_rank &rank_c_j
+		) const;
+		
+		std::tuple <size_type, size_type, size_type> lex_count(size_type const i, size_type const j, value_type const c) const;
+		std::pair <size_type, size_type> lex_smaller_count(size_type const i, value_type const c) const;
+		
+		size_type serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name = "") const;
+		void load(std::istream &in);
+	};
+	
+	
+	template <typename t_wt>
+	struct is_small_alphabet_wt : public std::false_type {};
+	
+	template <typename t_fallback>
+	struct is_small_alphabet_wt <small_alphabet_wt <t_fallback>> : public std::true_type {};
+	
+	
+	template <typename t_fallback>
+	small_alphabet_wt <t_fallback>::small_alphabet_wt(sdsl::int_vector_buffer <8> &buf, size_type const size):
+		m_size(size)
+	{
+		// Count the distinct symbols.
+		std::array <size_type, 256> counts{};
+		for (size_type i(0); i < size; ++i)
+			++counts[buf[i]];
+		
+		m_sigma = std::count_if(counts.begin(), counts.end(), [](size_type const count) { return 0 < count; });
+		if (MAX_SIGMA < m_sigma)
+		{
+			fallback_type tmp(buf, size);
+			m_fallback.swap(tmp);
+			return;
+		}
+		
+		// Assign the codes in lexicographic order.
+		m_symbols = sdsl::int_vector <8>(MAX_SIGMA, 0);
+		m_codes = sdsl::int_vector <8>(256, MAX_SIGMA);
+		std::uint8_t code(0);
+		for (std::size_t c(0); c < 256; ++c)
+		{
+			if (counts[c])
+			{
+				m_symbols[code] = c;
+				m_codes[c] = code;
+				++code;
+			}
+		}
+		
+		construct_flat(buf, size);
+		m_is_flat = true;
+	}
+	
+	
+	template <typename t_fallback>
+	void small_alphabet_wt <t_fallback>::construct_flat(sdsl::int_vector_buffer <8> &buf, size_type const size)
+	{
+		// Allocate one additional block and superblock for rank(size, c).
+		auto const block_count(1 + size / BLOCK_SIZE);
+		auto const superblock_count(1 + size / SUPERBLOCK_SIZE);
+		m_blocks = mappable_vector <std::uint64_t>(block_count * BLOCK_WORDS, 0);
+		m_superblocks = mappable_vector <std::uint64_t>(superblock_count * MAX_SIGMA, 0);
+		
+		count_array counts{};
+		count_array superblock_counts{};
+		auto *blocks(m_blocks.data());
+		for (size_type i(0); i <= size; ++i)
+		{
+			auto const offset(i % BLOCK_SIZE);
+			auto *block(blocks + (i / BLOCK_SIZE) * BLOCK_WORDS);
+			
+			// Store the counts at the beginning of each block and superblock.
+			if (0 == offset)
+			{
+				if (0 == i % SUPERBLOCK_SIZE)
+				{
+					superblock_counts = counts;
+					auto const superblock_idx(i / SUPERBLOCK_SIZE);
+					for (std::size_t j(0); j < MAX_SIGMA; ++j)
+						m_superblocks[superblock_idx * MAX_SIGMA + j] = counts[j];
+				}
+				
+				for (std::size_t j(0); j < MAX_SIGMA; ++j)
+				{
+					std::uint64_t const count(counts[j] - superblock_counts[j]);
+					assert(count <= 0xffff);
+					block[j / 4] |= count << (16 * (j % 4));
+				}
+			}
+			
+			if (i == size)
+				break;
+			
+			// Store the bits of the code.
+			auto const code(m_codes[buf[i]]);
+			auto *planes(block + COUNT_WORDS);
+			auto const word_idx(offset / 64);
+			auto const bit_idx(offset % 64);
+			for (std::size_t j(0); j < PLANE_COUNT; ++j)
+				planes[j * WORDS_PER_PLANE + word_idx] |= std::uint64_t((code >> j) & 0x1) << bit_idx;
+			
+			++counts[code];
+		}
+	}
+	
+	
+	template <typename t_fallback>
+	void small_alphabet_wt <t_fallback>::swap(small_alphabet_wt &other)
+	{
+		if (this != &other)
+		{
+			m_blocks.swap(other.m_blocks);
+			m_superblocks.swap(other.m_superblocks);
+			m_symbols.swap(other.m_symbols);
+			m_codes.swap(other.m_codes);
+			m_fallback.swap(other.m_fallback);
+			std::swap(m_size, other.m_size);
+			std::swap(m_sigma, other.m_sigma);
+			std::swap(m_is_flat, other.m_is_flat);
+		}
+	}
+	
+	
+	template <typename t_fallback>
+	auto small_alphabet_wt <t_fallback>::select(size_type const i, value_type const c) const -> size_type
+	{
+		if (!m_is_flat)
+			return m_fallback.select(i, c);
+		
+		assert(0 < i);
+		auto const code(m_codes[c]);
+		assert(MAX_SIGMA != code);
+		assert(i <= rank_code(m_size, code));
+		
+		// Find the last superblock that has less than i occurrences before it.
+		size_type superblock_idx(0);
+		{
+			size_type lb(0);
+			size_type rb(m_superblocks.size() / MAX_SIGMA);
+			while (1 < rb - lb)
+			{
+				auto const mid(lb + (rb - lb) / 2);
+				if (m_superblocks[mid * MAX_SIGMA + code] < i)
+					lb = mid;
+				else
+					rb = mid;
+			}
+			superblock_idx = lb;
+		}
+		
+		// Find the last block in the superblock in the same manner.
+		auto remaining(i - m_superblocks[superblock_idx * MAX_SIGMA + code]);
+		size_type block_idx(0);
+		{
+			auto const blocks_per_superblock(SUPERBLOCK_SIZE / BLOCK_SIZE);
+			size_type lb(superblock_idx * blocks_per_superblock);
+			size_type rb(std::min(lb + blocks_per_superblock, m_blocks.size() / BLOCK_WORDS));
+			while (1 < rb - lb)
+			{
+				auto const mid(lb + (rb - lb) / 2);
+				if (block_count(block_ptr(mid), code) < remaining)
+					lb = mid;
+				else
+					rb = mid;
+			}
+			block_idx = lb;
+		}
+		
+		// Scan the block.
+		auto const *block(block_ptr(block_idx));
+		remaining -= block_count(block, code);
+		for (std::size_t j(0); j < WORDS_PER_PLANE; ++j)
+		{
+			auto const mask(match_mask(block, j, code));
+			auto const count(sdsl::bits::cnt(mask));
+			if (remaining <= count)
+				return block_idx * BLOCK_SIZE + 64 * j + sdsl::bits::sel(mask, remaining);
+			remaining -= count;
+		}
+		
+		assert(0);
+		return m_size;
+	}
+	
+	
+	template <typename t_fallback>
+	template <typename t_cs, typename t_rank>
+	void small_alphabet_wt <t_fallback>::interval_symbols(
+		size_type const i,
+		size_type const j,
+		size_type &k,
+		t_cs &cs,
+		t_rank &rank_c_i,
+		t_rank &rank_c_j
+	) const
+	{
+		if (!m_is_flat)
+		{
+			sdsl::interval_symbols(m_fallback, i, j, k, cs, rank_c_i, rank_c_j);
+			return;
+		}
+		
+		assert(i <= j);
+		assert(j <= m_size);
+		k = 0;
+		if (i == j)
+			return;
+		
+		count_array ranks_i{};
+		count_array ranks_j{};
+		rank_codes(i, j, ranks_i, ranks_j);
+		
+		// Output the symbols in lexicographic order.
+		for (std::uint8_t code(0); code < m_sigma; ++code)
+		{
+			if (ranks_i[code] < ranks_j[code])
+			{
+				cs[k] = m_symbols[code];
+				rank_c_i[k] = ranks_i[code];
+				rank_c_j[k] = ranks_j[code];
+				++k;
+			}
+		}
+	}
+	
+	
+	template <typename t_fallback>
+	auto small_alphabet_wt <t_fallback>::lex_count(size_type const i, size_type const j, value_type const c) const -> std::tuple <size_type, size_type, size_type>
+	{
+		if (!m_is_flat)
+			return m_fallback.lex_count(i, j, c);
+		
+		assert(i <= j);
+		assert(j <= m_size);
+		
+		// Count the occurrences of the symbols that are smaller than or equal to c.
+		size_type rank(0), smaller(0), smaller_or_equal(0);
+		for (std::uint8_t code(0); code < m_sigma && m_symbols[code] <= c; ++code)
+		{
+			auto const rank_i(rank_code(i, code));
+			auto const count(rank_code(j, code) - rank_i);
+			smaller_or_equal += count;
+			if (m_symbols[code] == c)
+				rank = rank_i;
+			else
+				smaller += count;
+		}
+		
+		return std::make_tuple(rank, smaller, j - i - smaller_or_equal);
+	}
+	
+	
+	template <typename t_fallback>
+	auto small_alphabet_wt <t_fallback>::lex_smaller_count(size_type const i, value_type const c) const -> std::pair <size_type, size_type>
+	{
+		if (!m_is_flat)
+			return m_fallback.lex_smaller_count(i, c);
+		
+		auto const res(lex_count(0, i, c));
+		return std::make_pair(std::get <0>(res), std::get <1>(res));
+	}
+	
+	
+	template <typename t_fallback>
+	auto small_alphabet_wt <t_fallback>::serialize(
+		std::ostream &out,
+		sdsl::structure_tree_node *v,
+		std::string name
+	) const -> size_type
+	{
+		sdsl::structure_tree_node *child(sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this)));
+		size_type written_bytes(0);
+		
+		written_bytes += sdsl::write_member(m_size, out, child, "size");
+		written_bytes += sdsl::write_member(m_sigma, out, child, "sigma");
+		written_bytes += sdsl::write_member(m_is_flat, out, child, "is_flat");
+		written_bytes += m_blocks.serialize(out, child, "blocks");
+		written_bytes += m_superblocks.serialize(out, child, "superblocks");
+		written_bytes += m_symbols.serialize(out, child, "symbols");
+		written_bytes += m_codes.serialize(out, child, "codes");
+		written_bytes += m_fallback.serialize(out, child, "fallback");
+		
+		sdsl::structure_tree::add_size(child, written_bytes);
+		return written_bytes;
+	}
+	
+	
+	template <typename t_fallback>
+	void small_alphabet_wt <t_fallback>::load(std::istream &in)
+	{
+		sdsl::read_member(m_size, in);
+		sdsl::read_member(m_sigma, in);
+		sdsl::read_member(m_is_flat, in);
+		m_blocks.load(in);
+		m_superblocks.load(in);
+		m_symbols.load(in);
+		m_codes.load(in);
+		m_fallback.load(in);
+	}
+}
+
+#endif
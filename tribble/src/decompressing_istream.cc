@@ -0,0 +1,260 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#include <algorithm>
+#include <boost/iostreams/categories.hpp>
+#include <boost/iostreams/filter/bzip2.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <tribble/decompressing_istream.hh>
+#include <unistd.h>
+
+namespace ios = boost::iostreams;
+
+
+namespace {
+	
+	// Read a file descriptor. The bytes that were read for detecting the
+	// compression are returned first.
+	class prefixed_fd_source
+	{
+	public:
+		typedef char				char_type;
+		typedef ios::source_tag		category;
+		
+	protected:
+		std::array <char, 3>	m_prefix{};
+		std::size_t				m_prefix_size{0};
+		std::size_t				m_prefix_pos{0};
+		int						m_fd{-1};
+		
+	public:
+		prefixed_fd_source(int const fd):
+			m_fd(fd)
+		{
+		}
+		
+		char const *prefix() const { return m_prefix.data(); }
+		std::size_t prefix_size() const { return m_prefix_size; }
+		
+		// Fill the prefix.
+		void read_prefix()
+		{
+			while (m_prefix_size < m_prefix.size())
+			{
+				auto const res(read_fd(m_prefix.data() + m_prefix_size, m_prefix.size() - m_prefix_size));
+				if (0 == res)
+					break;
+				m_prefix_size += res;
+			}
+		}
+		
+		std::streamsize read_fd(char *dst, std::size_t const count)
+		{
+			while (true)
+			{
+				auto const res(::read(m_fd, dst, count));
+				if (-1 != res)
+					return res;
+				
+				if (EINTR != errno)
+				{
+					std::stringstream output;
+					output << "Unable to read the input: " << std::strerror(errno);
+					throw std::runtime_error(output.str());
+				}
+			}
+		}
+		
+		std::streamsize read(char *dst, std::streamsize const count)
+		{
+			if (m_prefix_pos < m_prefix_size)
+			{
+				auto const copied(std::min(std::size_t(count), m_prefix_size - m_prefix_pos));
+				std::copy_n(m_prefix.data() + m_prefix_pos, copied, dst);
+				m_prefix_pos += copied;
+				return copied;
+			}
+			
+			auto const res(read_fd(dst, count));
+			return (res ? res : -1);
+		}
+	};
+}
+
+
+namespace tribble {
+	
+	compression_type detect_compression(char const *magic, std::size_t const size)
+	{
+		if (2 <= size && '\x1f' == magic[0] && '\x8b' == magic[1])
+			return compression_type::GZIP;
+		
+		if (3 <= size && 'B' == magic[0] && 'Z' == magic[1] && 'h' == magic[2])
+			return compression_type::BZIP2;
+		
+		return compression_type::NONE;
+	}
+	
+	
+	void decompressing_streambuf::open(int const fd)
+	{
+		close();
+		
+		m_data.resize(BLOCK_COUNT * BLOCK_SIZE);
+		m_exception = nullptr;
+		m_read_count = 0;
+		m_write_count = 0;
+		m_fd = fd;
+		m_has_current_block = false;
+		m_producer_finished = false;
+		m_should_stop = false;
+		setg(nullptr, nullptr, nullptr);
+		
+		m_thread = std::thread([this](){ produce(); });
+	}
+	
+	
+	void decompressing_streambuf::close()
+	{
+		if (m_thread.joinable())
+		{
+			{
+				std::lock_guard <std::mutex> lock(m_mutex);
+				m_should_stop = true;
+			}
+			m_cv.notify_all();
+			m_thread.join();
+		}
+		
+		if (-1 != m_fd)
+		{
+			::close(m_fd);
+			m_fd = -1;
+		}
+	}
+	
+	
+	void decompressing_streambuf::produce()
+	{
+		try
+		{
+			prefixed_fd_source source(m_fd);
+			source.read_prefix();
+			
+			ios::filtering_istream stream;
+			switch (detect_compression(source.prefix(), source.prefix_size()))
+			{
+				case compression_type::GZIP:
+					stream.push(ios::gzip_decompressor());
+					break;
+					
+				case compression_type::BZIP2:
+					stream.push(ios::bzip2_decompressor());
+					break;
+					
+				case compression_type::NONE:
+				default:
+					break;
+			}
+			
+			stream.push(source);
+			stream.exceptions(std::ios_base::badbit);
+			write_blocks(stream);
+		}
+		catch (...)
+		{
+			std::lock_guard <std::mutex> lock(m_mutex);
+			m_exception = std::current_exception();
+		}
+		
+		{
+			std::lock_guard <std::mutex> lock(m_mutex);
+			m_producer_finished = true;
+		}
+		m_cv.notify_all();
+	}
+	
+	
+	void decompressing_streambuf::write_blocks(std::istream &stream)
+	{
+		while (true)
+		{
+			// Wait for a free block.
+			{
+				std::unique_lock <std::mutex> lock(m_mutex);
+				m_cv.wait(lock, [this](){ return m_should_stop || m_write_count - m_read_count < BLOCK_COUNT; });
+				if (m_should_stop)
+					return;
+			}
+			
+			// The block is not accessed by the reading thread before it has been published.
+			auto const block_idx(m_write_count % BLOCK_COUNT);
+			stream.read(m_data.data() + block_idx * BLOCK_SIZE, BLOCK_SIZE);
+			std::size_t const count(stream.gcount());
+			
+			if (count)
+			{
+				{
+					std::lock_guard <std::mutex> lock(m_mutex);
+					m_block_sizes[block_idx] = count;
+					++m_write_count;
+				}
+				m_cv.notify_all();
+			}
+			
+			if (count < BLOCK_SIZE)
+				return;
+		}
+	}
+	
+	
+	auto decompressing_streambuf::underflow() -> int_type
+	{
+		if (gptr() < egptr())
+			return traits_type::to_int_type(*gptr());
+		
+		std::unique_lock <std::mutex> lock(m_mutex);
+		
+		// Release the current block.
+		if (m_has_current_block)
+		{
+			++m_read_count;
+			m_has_current_block = false;
+			m_cv.notify_all();
+		}
+		
+		m_cv.wait(lock, [this](){ return m_producer_finished || m_read_count < m_write_count; });
+		if (m_read_count < m_write_count)
+		{
+			auto const block_idx(m_read_count % BLOCK_COUNT);
+			auto *block(m_data.data() + block_idx * BLOCK_SIZE);
+			setg(block, block, block + m_block_sizes[block_idx]);
+			m_has_current_block = true;
+			return traits_type::to_int_type(*gptr());
+		}
+		
+		setg(nullptr, nullptr, nullptr);
+		if (m_exception)
+			std::rethrow_exception(m_exception);
+		
+		return traits_type::eof();
+	}
+}
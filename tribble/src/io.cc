@@ -16,6 +16,7 @@
 
 #include <fcntl.h>
 #include <iostream>
+#include <sys/stat.h>
 #include <tribble/io.hh>
 
 namespace ios = boost::iostreams;
@@ -45,6 +46,36 @@ namespace tribble {
 	}
 
 
+	void open_file_for_reading(char const *fname, mapped_file_istream &stream)
+	{
+		int fd(open(fname, O_RDONLY));
+		if (-1 == fd)
+			handle_file_error(fname);
+		
+		stream.open(fd);
+	}
+
+
+	void open_file_for_reading(char const *fname, mapped_file &file)
+	{
+		int fd(open(fname, O_RDONLY));
+		if (-1 == fd)
+			handle_file_error(fname);
+		
+		file.open(fd);
+	}
+
+
+	void open_file_for_reading(char const *fname, decompressing_istream &stream)
+	{
+		int fd(open(fname, O_RDONLY));
+		if (-1 == fd)
+			handle_file_error(fname);
+		
+		stream.open(fd);
+	}
+
+
 	void open_file_for_writing(char const *fname, file_ostream &stream)
 	{
 		int fd(open(fname, O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR));
@@ -54,4 +85,14 @@ namespace tribble {
 		ios::file_descriptor_sink sink(fd, ios::close_handle);
 		stream.open(sink);
 	}
+	
+	
+	bool is_regular_file(char const *fname)
+	{
+		struct stat sb;
+		if (-1 == stat(fname, &sb))
+			handle_file_error(fname);
+		
+		return S_ISREG(sb.st_mode);
+	}
 }
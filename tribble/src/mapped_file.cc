@@ -0,0 +1,155 @@
+/*
+ Copyright (c) 2016 Tuukka Norri
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see http://www.gnu.org/licenses/ .
+ */
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <tribble/mapped_file.hh>
+#include <unistd.h>
+
+
+namespace {
+	
+	void throw_with_errno(char const *message)
+	{
+		std::stringstream output;
+		output << message << ": " << std::strerror(errno);
+		throw std::runtime_error(output.str());
+	}
+}
+
+
+namespace tribble {
+	
+	void mapped_file::open(int const fd)
+	{
+		close();
+		
+		struct stat sb;
+		if (-1 == fstat(fd, &sb))
+		{
+			::close(fd);
+			throw_with_errno("Unable to stat the file");
+		}
+		
+		// mmap does not accept empty mappings.
+		std::size_t const size(sb.st_size);
+		if (size)
+		{
+			void *data(mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0));
+			if (MAP_FAILED == data)
+			{
+				::close(fd);
+				throw_with_errno("Unable to map the file");
+			}
+			
+			m_data = static_cast <char const *>(data);
+			m_size = size;
+		}
+		
+		::close(fd);
+	}
+	
+	
+	void mapped_file::advise_sequential() const
+	{
+		if (m_data)
+			madvise(const_cast <char *>(m_data), m_size, MADV_SEQUENTIAL);
+	}
+	
+	
+	void advise_random(char const *data, std::size_t const size)
+	{
+		if (!size)
+			return;
+		
+		// madvise requires the address to be aligned to the page size.
+		std::uintptr_t const page_size(sysconf(_SC_PAGESIZE));
+		auto const begin(reinterpret_cast <std::uintptr_t>(data));
+		auto const aligned_begin(begin - begin % page_size);
+		madvise(reinterpret_cast <void *>(aligned_begin), begin + size - aligned_begin, MADV_RANDOM);
+	}
+	
+	
+	void mapped_file::close()
+	{
+		if (m_data)
+		{
+			munmap(const_cast <char *>(m_data), m_size);
+			m_data = nullptr;
+			m_size = 0;
+		}
+	}
+	
+	
+	void memory_streambuf::set_buffer(char const *data, std::size_t const size)
+	{
+		// std::streambuf does not modify the get area.
+		auto *begin(const_cast <char *>(data));
+		setg(begin, begin, begin + size);
+	}
+	
+	
+	void memory_streambuf::skip(std::size_t const count)
+	{
+		if (available() < count)
+			throw std::runtime_error("Tried to skip past the end of the buffer.");
+		
+		setg(eback(), gptr() + count, egptr());
+	}
+	
+	
+	auto memory_streambuf::seekoff(
+		off_type off,
+		std::ios_base::seekdir dir,
+		std::ios_base::openmode which
+	) -> pos_type
+	{
+		if (! (which & std::ios_base::in))
+			return pos_type(off_type(-1));
+		
+		off_type base(0);
+		if (std::ios_base::cur == dir)
+			base = gptr() - eback();
+		else if (std::ios_base::end == dir)
+			base = egptr() - eback();
+		
+		off_type const pos(base + off);
+		if (pos < 0 || egptr() - eback() < pos)
+			return pos_type(off_type(-1));
+		
+		setg(eback(), eback() + pos, egptr());
+		return pos_type(pos);
+	}
+	
+	
+	auto memory_streambuf::seekpos(pos_type pos, std::ios_base::openmode which) -> pos_type
+	{
+		return seekoff(off_type(pos), std::ios_base::beg, which);
+	}
+	
+	
+	void mapped_file_istream::open(int const fd)
+	{
+		m_file.open(fd);
+		m_buffer.set_buffer(m_file.data(), m_file.size());
+		clear();
+	}
+}
@@ -18,6 +18,7 @@
 #include <thread>
 #include <tribble/dispatch_fn.hh>
 #include <tribble/fasta_reader.hh>
+#include <tribble/fastq_reader.hh>
 #include <tribble/io.hh>
 #include <tribble/line_reader.hh>
 #include "verify_superstring.hh"
@@ -28,6 +29,7 @@ namespace {
 	class verify_context
 	{
 	protected:
+		tribble::mapped_file_istream								m_cst_stream;	// Outlives m_cst, which may refer to the mapping.
 		tribble::cst_type											m_cst{};
 		dispatch_queue_t											m_loading_queue{};
 		dispatch_queue_t											m_verifying_queue{};
@@ -113,17 +115,17 @@ namespace {
 			std::string source_fname(source_fname_);
 
 			auto load_ds_fn = [this, cst_fname = std::move(cst_fname)](){
-				tribble::file_istream ds_stream;
-				tribble::open_file_for_reading(cst_fname.c_str(), ds_stream);
+				tribble::open_file_for_reading(cst_fname.c_str(), m_cst_stream);
 				
 				// Load the CST.
 				std::cerr << "Loading the CST…" << std::endl;
-				m_cst.load(ds_stream);
+				m_cst.load(m_cst_stream);
 				std::cerr << "Loading complete." << std::endl;
 			};
 			
 			auto read_sequences_fn = [this, source_fname = std::move(source_fname), source_format](){
-				tribble::file_istream source_stream;
+				// The source file may be compressed.
+				tribble::decompressing_istream source_stream;
 				tribble::open_file_for_reading(source_fname.c_str(), source_stream);
 				
 				if (source_format_arg_FASTA == source_format)
@@ -131,6 +133,11 @@ namespace {
 					tribble::fasta_reader <verify_context> reader;
 					reader.read_from_stream(source_stream, m_vs, *this);
 				}
+				else if (source_format_arg_FASTQ == source_format)
+				{
+					tribble::fastq_reader <verify_context> reader;
+					reader.read_from_stream(source_stream, m_vs, *this);
+				}
 				else if (source_format_arg_text == source_format)
 				{
 					tribble::line_reader <verify_context> reader;
@@ -19,11 +19,12 @@
 
 #include <istream>
 #include <sdsl/cst_sct3.hpp>
+#include <tribble/small_alphabet_wt.hh>
 #include "cmdline.h" // For enum_source_format
 
 namespace tribble {
 	
-	typedef sdsl::wt_hutu <>							wt_type;
+	typedef small_alphabet_wt <sdsl::wt_hutu <>>		wt_type;
 	typedef sdsl::csa_wt <wt_type, 1 << 20, 1 << 20>	csa_type;
 	typedef sdsl::lcp_support_tree2 <256>				lcp_support_type;
 	typedef sdsl::cst_sct3 <csa_type, lcp_support_type>	cst_type;